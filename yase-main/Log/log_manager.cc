@@ -8,6 +8,7 @@
  * Not for distribution without prior approval.
  */
 #include <fcntl.h>
+#include <sys/stat.h>
 #include <unistd.h>
 #include "log_manager.h"
 #include "Storage/file.h"
@@ -16,26 +17,34 @@ namespace yase {
 
 LogManager *LogManager::instance = nullptr;
 
-LogManager::LogManager(const char *log_filename, uint32_t logbuf_mb) {
+LogManager::LogManager(const char *log_filename, uint32_t logbuf_mb, bool open_existing) {
   // TODO: Your implementation.
   logbuf_size = logbuf_mb * 1024 * 1024;
   logbuf = new char[logbuf_size];
   logbuf_offset = 0;
   
-  fd = open(log_filename, O_CREAT|O_RDWR|O_TRUNC, S_IRUSR|S_IWUSR);
+  fd = open(log_filename, O_CREAT|O_RDWR|(open_existing ? 0 : O_TRUNC), S_IRUSR|S_IWUSR);
   if (fd < 0) {
     abort();
   }
 
+  // LSNs are log file offsets, so an existing log continues at its end
   durable_lsn = 0;
-  current_lsn = 0;
+  if (open_existing) {
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+      abort();
+    }
+    durable_lsn = st.st_size;
+  }
+  current_lsn = durable_lsn;
 };
 
 LogManager::~LogManager() {
   // TODO: Your implementation.
   LogManager::Flush();
   delete[] logbuf;
-  int ret = fsync(fd);
+  int ret = fdatasync(fd);
   if (ret < 0) {
     abort();
   }
@@ -236,7 +245,9 @@ bool LogManager::Flush() {
     return false;
   }
 
-  if (fsync(fd) < 0) {
+  // The log is the only thing forced at commit; data pages are synced at
+  // checkpoints
+  if (fdatasync(fd) < 0) {
     return false;
   }
   durable_lsn = current_lsn;
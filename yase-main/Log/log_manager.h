@@ -67,13 +67,19 @@ struct LogManager {
   // Constructor
   // @log_filename: file name for the persistent log
   // @logbuf_mb: log buffer size in MB
-  LogManager(const char *log_filename, uint32_t logbuf_mb);
+  // @open_existing: append to an existing log instead of truncating it; LSNs
+  //                 continue from the end of the log
+  LogManager(const char *log_filename, uint32_t logbuf_mb, bool open_existing = false);
   ~LogManager();
 
-  inline static void Initialize(const char *log_filename, uint32_t logbuf_mb) {
-    LogManager::instance = new LogManager(log_filename, logbuf_mb);
+  inline static void Initialize(const char *log_filename, uint32_t logbuf_mb,
+                                bool open_existing = false) {
+    LogManager::instance = new LogManager(log_filename, logbuf_mb, open_existing);
+  }
+  inline static void Uninitialize() {
+    delete instance;
+    instance = nullptr;
   }
-  inline static void Uninitialize() { delete instance; }
   inline static LogManager *Get() { return instance; }
 
   // Log an insert operation
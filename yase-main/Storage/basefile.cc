@@ -8,11 +8,16 @@
  * Not for distribution without prior approval.
  */
 #include <fcntl.h>
+#include <sys/stat.h>
 #include "basefile.h"
+#include "page.h"
 
 namespace yase {
 
-BaseFile::BaseFile(std::string name) {
+// Page of zeros for initializing new pages, aligned for direct I/O
+alignas(BaseFile::kDefaultDirectAlignment) static const char kZeroPage[kMaxPageSize] = {0};
+
+BaseFile::BaseFile(std::string name, bool direct_io, uint32_t page_size, bool open_existing) {
   // Example error handling code:
   // - Using glog to throw a fatal error if ret is less than 0 with a message "error"
   //   LOG_IF(FATAL, ret < 0) << "error";
@@ -22,48 +27,204 @@ BaseFile::BaseFile(std::string name) {
   //   }
   //
   // TODO: Your implementation
-  id = open(name.c_str(), O_CREAT|O_RDWR|O_TRUNC, S_IRUSR|S_IWUSR);
+  LOG_IF(FATAL, !IsValidPageSize(page_size)) << "Unsupported page size " << page_size;
+  this->page_size = page_size;
+  this->direct_io = false;
+  io_alignment = 1;
+  int flags = O_CREAT|O_RDWR|(open_existing ? 0 : O_TRUNC);
+  if (direct_io) {
+    id = open(name.c_str(), flags|O_DIRECT, S_IRUSR|S_IWUSR);
+    if (id >= 0) {
+      this->direct_io = true;
+      io_alignment = kDefaultDirectAlignment;
+#ifdef STATX_DIOALIGN
+      struct statx stx;
+      if (statx(id, "", AT_EMPTY_PATH, STATX_DIOALIGN, &stx) == 0 &&
+          (stx.stx_mask & STATX_DIOALIGN) && stx.stx_dio_mem_align > 0) {
+        io_alignment = std::max(stx.stx_dio_mem_align, stx.stx_dio_offset_align);
+      }
+#endif
+      LOG_IF(FATAL, page_size % io_alignment) << "Page size is not a multiple of the direct I/O alignment";
+    } else {
+      LOG(WARNING) << "Direct I/O not supported for " << name << ", using buffered I/O";
+    }
+  }
+  if (!this->direct_io) {
+    id = open(name.c_str(), flags, S_IRUSR|S_IWUSR);
+  }
   if (id < 0) {
     abort();
   }
+  LOG_IF(FATAL, id > (int)PageId::kMaxFileId) << "File descriptor does not fit in a page ID";
   page_count = 0;
+  if (open_existing) {
+    // Pages are created whole, so the size is a multiple of the page size
+    // unless a crash tore the last page's creation; such a page was never
+    // handed out and is overwritten by the next CreatePage
+    struct stat st;
+    LOG_IF(FATAL, fstat(id, &st) != 0) << "Failed to stat " << name;
+    uint64_t pages = (uint64_t)st.st_size / page_size;
+    LOG_IF(FATAL, pages > (uint64_t)PageId::kMaxPageNum + 1) << "File too large: " << name;
+    LOG_IF(WARNING, st.st_size % page_size) << "Ignoring partial last page of " << name;
+    page_count = pages;
+  }
+  // Any space preallocated past the end before is reserved again on demand
+  reserved_pages = page_count.load();
+  preallocate = true;
+}
+
+// Direct I/O needs an aligned buffer; others go through an aligned bounce
+// buffer (slow, but only the buffer pool's frames are used for bulk I/O)
+static bool DirectIo(int fd, bool write, void *buf, uint32_t len, off_t offset,
+                     uint32_t alignment) {
+  if ((uintptr_t)buf % alignment == 0) {
+    return (write ? pwrite(fd, buf, len, offset) : pread(fd, buf, len, offset)) ==
+           len;
+  }
+  void *bounce = aligned_alloc(alignment, len);
+  LOG_IF(FATAL, !bounce) << "Failed allocating bounce buffer";
+  bool success;
+  if (write) {
+    memcpy(bounce, buf, len);
+    success = pwrite(fd, bounce, len, offset) == len;
+  } else {
+    success = pread(fd, bounce, len, offset) == len;
+    if (success) {
+      memcpy(buf, bounce, len);
+    }
+  }
+  free(bounce);
+  return success;
 }
 
 BaseFile::~BaseFile() {
   // TODO: Your implementation
-  int ret = fsync(id);
-  if (ret < 0) {
+  if (!Sync()) {
     abort();
   }
   close(id);
 }
 
+bool BaseFile::Sync() {
+  return fdatasync(id) == 0;
+}
+
 bool BaseFile::FlushPage(PageId pid, void *page) {
   // TODO: Your implementation
   if (!pid.IsValid()) { return false; }
-  off_t offset = pid.GetPageNum() * PAGE_SIZE;
-  int ret = fsync(id);
-  if (ret < 0) {
-    abort();
+  off_t offset = (off_t)pid.GetPageNum() * page_size;
+  if (direct_io) {
+    return DirectIo(id, true, page, page_size, offset, io_alignment);
   }
-  return pwrite(id, page, PAGE_SIZE, offset) == PAGE_SIZE;
+  return pwrite(id, page, page_size, offset) == page_size;
 }
 
 bool BaseFile::LoadPage(PageId pid, void *out_buf) {
   // TODO: Your implementation
   if (!pid.IsValid()) { return false; }
-  off_t offset = pid.GetPageNum() * PAGE_SIZE;
-  return pread(id, out_buf, PAGE_SIZE, offset) == PAGE_SIZE;
+  off_t offset = (off_t)pid.GetPageNum() * page_size;
+  if (direct_io) {
+    return DirectIo(id, false, out_buf, page_size, offset, io_alignment);
+  }
+  return pread(id, out_buf, page_size, offset) == page_size;
+}
+
+bool BaseFile::ReserveExtent(uint32_t page_num) {
+  if (page_num < reserved_pages.load()) {
+    return true;
+  }
+  if (!preallocate) {
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(extent_mutex);
+  uint32_t reserved = reserved_pages.load();
+  if (page_num < reserved) {
+    return true;
+  }
+
+  // Grow extents with the file (by an eighth of it), so big files get few
+  // large extents and small files don't waste much
+  uint32_t extent = std::min(std::max(reserved / 8, kMinExtentPages), kMaxExtentPages);
+  uint32_t end = std::min<uint64_t>(std::max<uint64_t>(page_num + 1ULL, (uint64_t)reserved + extent),
+                                    (uint64_t)PageId::kMaxPageNum + 1);
+  if (fallocate(id, FALLOC_FL_KEEP_SIZE, (off_t)reserved * page_size,
+                (off_t)(end - reserved) * page_size) != 0) {
+    // E.g., the file system doesn't support it; write zeros from now on
+    preallocate = false;
+    return false;
+  }
+  reserved_pages = end;
+  return true;
+}
+
+bool BaseFile::PunchPages(uint32_t first, uint32_t count) {
+  return fallocate(id, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, (off_t)first * page_size,
+                   (off_t)count * page_size) == 0;
+}
+
+bool BaseFile::FillPages(uint32_t first, uint32_t count) {
+  return fallocate(id, FALLOC_FL_KEEP_SIZE, (off_t)first * page_size,
+                   (off_t)count * page_size) == 0;
+}
+
+bool BaseFile::Truncate(uint32_t count) {
+  // Space preallocated past the end goes too
+  std::lock_guard<std::mutex> lock(extent_mutex);
+  if (ftruncate(id, (off_t)count * page_size) != 0) {
+    return false;
+  }
+  page_count = count;
+  reserved_pages = count;
+  return true;
+}
+
+void BaseFile::PrepareLoad(IoRequest *req, PageId pid, void *out_buf) {
+  req->fd = id;
+  req->write = false;
+  req->buf = out_buf;
+  req->len = page_size;
+  req->offset = (uint64_t)pid.GetPageNum() * page_size;
+}
+
+void BaseFile::PrepareFlush(IoRequest *req, PageId pid, void *page) {
+  req->fd = id;
+  req->write = true;
+  req->buf = page;
+  req->len = page_size;
+  req->offset = (uint64_t)pid.GetPageNum() * page_size;
 }
 
 PageId BaseFile::CreatePage() {
   // TODO: Your implementation
-  PageId pid(id, page_count.fetch_add(1));
-  char buffer[PAGE_SIZE] = {0};
-  if (!FlushPage(pid, buffer)) {
-    page_count--;
+  return CreatePages(1);
+}
+
+PageId BaseFile::CreatePages(uint32_t count) {
+  if (count == 0) {
     return PageId();
   }
+  uint32_t page_num = page_count.fetch_add(count);
+  if ((uint64_t)page_num + count - 1 > PageId::kMaxPageNum) {
+    // The file is full; page numbers must not wrap around
+    page_count -= count;
+    return PageId();
+  }
+  PageId pid(id, page_num);
+
+  // Space in a reserved extent is zeroed already; only the file size needs
+  // to cover the new pages (fallocate never shrinks the file, so concurrent
+  // creations can't race on it)
+  if (ReserveExtent(page_num + count - 1) &&
+      fallocate(id, 0, (off_t)page_num * page_size, (off_t)count * page_size) == 0) {
+    return pid;
+  }
+  for (uint32_t i = 0; i < count; ++i) {
+    if (!FlushPage(PageId(id, page_num + i), (void *)kZeroPage)) {
+      page_count -= count;
+      return PageId();
+    }
+  }
   return pid;
 }
 
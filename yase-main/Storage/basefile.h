@@ -12,38 +12,110 @@
 #include <atomic>
 #include <mutex>
 #include "../yase_internal.h"
+#include "io_engine.h"
 
 namespace yase {
 
 // Low-level primitives for reading and writing pages
 struct BaseFile {
+  // Buffer alignment required for direct I/O if the file system doesn't
+  // report one
+  static constexpr uint32_t kDefaultDirectAlignment = 4096;
+
   BaseFile() {}
-  BaseFile(std::string name);
+
+  // @name: file name
+  // @direct_io: bypass the kernel page cache (O_DIRECT); falls back to
+  //             buffered I/O if the file system doesn't support it
+  // @page_size: size of the file's pages, a power of two between
+  //             kMinPageSize and kMaxPageSize (see page.h)
+  // @open_existing: keep the file's contents if it exists (the page count is
+  //                 derived from its size) instead of truncating it
+  BaseFile(std::string name, bool direct_io = false, uint32_t page_size = PAGE_SIZE,
+           bool open_existing = false);
   ~BaseFile();
 
-  // Write a page to storage
+  // Write a page to storage; the write is not durable until the next Sync
   bool FlushPage(PageId pid, void *page);
 
+  // Make all written pages durable (fdatasync); returns true/false if
+  // succeeded/failed
+  bool Sync();
+
   // Load a page from storage
   bool LoadPage(PageId pid, void *out_buf);
 
+  // Fill in [req] to read page [pid] into [out_buf] through an IoEngine
+  void PrepareLoad(IoRequest *req, PageId pid, void *out_buf);
+
+  // Fill in [req] to write [page] to page [pid] through an IoEngine
+  void PrepareFlush(IoRequest *req, PageId pid, void *page);
+
   // Create a new page in the file; returns the ID of the new page
   PageId CreatePage();
 
+  // Create [count] new pages with consecutive page numbers, all reading as
+  // zeros; returns the ID of the first one, or an invalid PageId if the file
+  // can't hold them
+  PageId CreatePages(uint32_t count);
+
+  // Return the space of pages [first, first + count) to the file system
+  // (FALLOC_FL_PUNCH_HOLE); the pages read as zeros afterwards
+  bool PunchPages(uint32_t first, uint32_t count);
+
+  // Allocate space again for pages [first, first + count), e.g., punched
+  // out before, without changing their contents
+  bool FillPages(uint32_t first, uint32_t count);
+
+  // Cut the file down to its first [count] pages. Caller must make sure no
+  // pages are created meanwhile.
+  bool Truncate(uint32_t count);
+
+  // Make sure space up to and including page [page_num] is reserved;
+  // returns false if the file system can't preallocate
+  bool ReserveExtent(uint32_t page_num);
+
   // Return the ID of this file
   inline int GetId() { return id; }
 
   // Return the number of created pages
   inline uint32_t GetPageCount() { return page_count; }
 
+  // Return the size of the file's pages in bytes
+  inline uint32_t GetPageSize() { return page_size; }
+
   //Return the file descriptor
   inline int GetFd() { return id; }
 
+  // Return true if the file is accessed with direct I/O
+  inline bool IsDirect() { return direct_io; }
+
+  // Return the alignment I/O buffers must have (1 unless direct I/O is used)
+  inline uint32_t GetIoAlignment() { return io_alignment; }
+
   // ID of this file, also the file descriptor of the underlying file
   int id;
 
   // Number of pages the file currently has
   std::atomic<uint32_t> page_count;
+
+  // Size of each page
+  uint32_t page_size;
+
+  // Space is preallocated (fallocate) in extents that grow with the file,
+  // from kMinExtentPages up to kMaxExtentPages; pages below reserved_pages
+  // have space. New pages in reserved space read as zeros, so they need not
+  // be written.
+  static constexpr uint32_t kMinExtentPages = 16;
+  static constexpr uint32_t kMaxExtentPages = 16384;
+  std::atomic<uint32_t> reserved_pages;
+  std::atomic<bool> preallocate;
+  std::mutex extent_mutex;
+
+  // Whether the file was opened with O_DIRECT, and the buffer alignment
+  // that requires; page sizes and offsets are multiples of it
+  bool direct_io;
+  uint32_t io_alignment;
 };
 
 }  // namespace yase
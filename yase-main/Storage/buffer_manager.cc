@@ -7,131 +7,404 @@
  *
  * Not for distribution without prior approval.
  */
+#include <sys/mman.h>
+
 #include "buffer_manager.h"
+#include "Log/log_manager.h"
 
 namespace yase {
 
 BufferManager *BufferManager::instance = nullptr;
 
+PageTable::PageTable(Page *frames, uint32_t frame_count) : frames(frames) {
+  // About two chains per frame keeps the chains short
+  uint32_t buckets = std::max<uint32_t>(frame_count * 2 / kPartitionCount, 1);
+  for (uint32_t i = 0; i < kPartitionCount; ++i) {
+    partitions[i].buckets.assign(buckets, Page::kInvalidFrame);
+  }
+}
+
+Page *PageTable::Find(PageId pid) {
+  uint32_t idx = GetBucket(pid);
+  while (idx != Page::kInvalidFrame) {
+    if (frames[idx].page_id.value == pid.value) {
+      return &frames[idx];
+    }
+    idx = frames[idx].hash_next;
+  }
+  return nullptr;
+}
+
+void PageTable::Insert(Page *page) {
+  uint32_t &head = GetBucket(page->page_id);
+  page->hash_next = head;
+  head = page->frame_id;
+}
+
+void PageTable::Remove(Page *page) {
+  uint32_t *link = &GetBucket(page->page_id);
+  while (*link != Page::kInvalidFrame) {
+    if (*link == page->frame_id) {
+      *link = page->hash_next;
+      page->hash_next = Page::kInvalidFrame;
+      return;
+    }
+    link = &frames[*link].hash_next;
+  }
+  LOG(FATAL) << "Frame not found in page table";
+}
+
 // Initialize a new buffer manager
-BufferManager::BufferManager(uint32_t page_count) {
+BufferManager::BufferManager(uint32_t page_count, Replacer::Policy policy,
+                             IoEngine::Backend backend)
+  : BufferManager(std::vector<SizeClassConfig>{{PAGE_SIZE, page_count}}, policy, backend) {}
+
+BufferManager::BufferManager(const std::vector<SizeClassConfig> &classes,
+                             Replacer::Policy policy, IoEngine::Backend backend) {
   // Allocate and initialize memory for page frames
   // 1. Initialize the page_count member variable
   // 2. Allocate and initialize the desired amount of memory (specified by page_count) 
   //    and store the address in member variable page_frames
   // 3. Clear the allocated memory to 0
   std::lock_guard<std::mutex> lock(buffer_mutex);
-  this->page_count = page_count;
+  LOG_IF(FATAL, classes.empty() || classes.size() > 256) << "Invalid number of size classes";
+
+  // Lay the classes out one after another, each aligned to its page size
+  page_count = 0;
+  size_t data_len = 0;
+  size_classes.resize(classes.size());
+  for (uint32_t c = 0; c < classes.size(); ++c) {
+    uint32_t page_size = classes[c].page_size;
+    LOG_IF(FATAL, !IsValidPageSize(page_size)) << "Unsupported page size " << page_size;
+    LOG_IF(FATAL, classes[c].frame_count == 0) << "Empty size class";
+    for (uint32_t o = 0; o < c; ++o) {
+      LOG_IF(FATAL, classes[o].page_size == page_size) << "Duplicate size class " << page_size;
+    }
+    size_classes[c].page_size = page_size;
+    size_classes[c].first_frame = page_count;
+    size_classes[c].frame_count = classes[c].frame_count;
+    page_count += classes[c].frame_count;
+    data_len = (data_len + page_size - 1) / page_size * page_size +
+               (size_t)classes[c].frame_count * page_size;
+  }
+  LOG_IF(FATAL, !GetSizeClass(PAGE_SIZE)) << "No size class for directory pages";
+
   page_frames = new Page[page_count];
-  for (uint32_t i = 0; i < page_count; ++i) {
-    new (&page_frames[i]) Page();
+  // Prefer reserved huge pages, then transparent huge pages; anonymous
+  // mappings come zeroed
+  frame_data_len = (data_len + kHugePageSize - 1) / kHugePageSize * kHugePageSize;
+  void *frames = mmap(nullptr, frame_data_len, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  if (frames == MAP_FAILED) {
+    frames = mmap(nullptr, frame_data_len, PROT_READ | PROT_WRITE,
+                  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    LOG_IF(FATAL, frames == MAP_FAILED) << "Failed allocating page frames";
+    madvise(frames, frame_data_len, MADV_HUGEPAGE);
+  }
+  frame_data = (char *)frames;
+  page_table = new PageTable(page_frames, page_count);
+  miss_count = 0;
+  victim_flush_count = 0;
+
+  // All frames start out free; hand out low frame indices first
+  size_t offset = 0;
+  for (uint32_t c = 0; c < size_classes.size(); ++c) {
+    SizeClass &sc = size_classes[c];
+    sc.replacer = Replacer::Create(policy, &page_frames[sc.first_frame], sc.frame_count);
+    sc.free_frames.reserve(sc.frame_count);
+    offset = (offset + sc.page_size - 1) / sc.page_size * sc.page_size;
+    for (uint32_t i = sc.first_frame; i < sc.first_frame + sc.frame_count; ++i) {
+      page_frames[i].frame_id = i;
+      page_frames[i].size_class = c;
+      page_frames[i].dirty_count = &dirty_count;
+      page_frames[i].page_data = &frame_data[offset];
+      offset += sc.page_size;
+    }
+    for (uint32_t i = sc.frame_count; i > 0; --i) {
+      sc.free_frames.push_back(sc.first_frame + i - 1);
+    }
+  }
+
+  // Start cleaning once a fifth of the pool is dirty, down to a tenth
+  dirty_count = 0;
+  cleaner_stop = false;
+  dirty_low_watermark = 0.1;
+  dirty_high_watermark = 0.2;
+  cleaner_cursor = 0;
+  writeback_pins = 0;
+  writeback_releases = 0;
+  cleaner = std::thread(&BufferManager::CleanerLoop, this);
+
+  // Read ahead at most a quarter of the pool, so a scan cannot flush it
+  // (ReadAheadLocked also caps it by the size of the file's class)
+  read_ahead_pages = std::min(kReadAheadPages, page_count / 4);
+  prefetch_in_flight = 0;
+
+  io_engine = IoEngine::Create(backend);
+  LOG_IF(FATAL, !io_engine) << "Failed creating the I/O engine";
+  io_engine->RegisterBuffers(frame_data, data_len);
+  frame_io.resize(page_count);
+  for (auto &req : frame_io) {
+    req.arg = this;
   }
 }
 
 BufferManager::~BufferManager() {
-  // Flush all dirty pages and free page frames
+  // Flush all dirty pages and free page frames; prefetches in flight
+  // finish first
+  DrainPrefetches();
+
+  {
+    std::lock_guard<std::mutex> lock(cleaner_mutex);
+    cleaner_stop = true;
+  }
+  cleaner_cv.notify_one();
+  cleaner.join();
 
   std::lock_guard<std::mutex> lock(buffer_mutex);
 
   for (uint32_t i = 0; i < page_count; ++i) {
     if (page_frames[i].IsDirty() && page_frames[i].GetPageId().IsValid()) {
-      BaseFile *file = file_map[page_frames[i].GetPageId().GetFileId()];
-      file->FlushPage(page_frames[i].GetPageId(), page_frames[i].page_data);
+      auto it = file_map.find(page_frames[i].GetPageId().GetFileId());
+      if (it != file_map.end()) {
+        it->second->FlushPage(page_frames[i].GetPageId(), page_frames[i].page_data);
+      }
     }
   }
 
-  for (auto& entry: page_map) {
-    delete entry.second;
+  delete io_engine;
+  for (auto &sc : size_classes) {
+    delete sc.replacer;
   }
-  page_map.clear();
-  lru.clear();
-
+  delete page_table;
   delete[] page_frames;
+  munmap(frame_data, frame_data_len);
 }
 
-Page* BufferManager::PinPage(PageId page_id) {
-  if (!page_id.IsValid()) {
-    return nullptr;
+BufferManager::SizeClass *BufferManager::GetSizeClass(uint32_t page_size) {
+  for (auto &sc : size_classes) {
+    if (sc.page_size == page_size) {
+      return &sc;
+    }
   }
-  std::lock_guard<std::mutex> lock(buffer_mutex);
-
-  auto it = page_map.find(page_id);
-  if (it != page_map.end()) {
-    it->second->IncPinCount();
+  return nullptr;
+}
 
-    lru.remove(it->second);
-    lru.push_back(it->second);
-    return it->second;
+Page *BufferManager::GetVictimFrame(SizeClass *sc, Page **out_dirty) {
+  *out_dirty = nullptr;
+  if (!sc->free_frames.empty()) {
+    Page *page = &page_frames[sc->free_frames.back()];
+    sc->free_frames.pop_back();
+    return page;
   }
 
-  if (page_map.size() >= page_count) {
-    bool evicted = false;
+  while (true) {
+    uint32_t slot = sc->replacer->Evict();
+    if (slot == Page::kInvalidFrame) {
+      return nullptr;
+    }
+    Page *victim = &page_frames[sc->first_frame + slot];
 
-    while (!lru.empty()) {
-      Page* victim = lru.front();
-      lru.pop_front();
+    // Pins only happen under the partition latch, so a frame still unpinned
+    // here can be unhooked safely; otherwise it was hit since the sweep
+    PageTable::Partition &part = page_table->GetPartition(victim->GetPageId());
+    {
+      std::lock_guard<std::mutex> part_lock(part.latch);
+      if (victim->GetPinCount() > 0) {
+        continue;
+      }
 
-      if (victim->GetPinCount() == 0) {
-        if (victim->IsDirty()) {
-          BaseFile* file = file_map[victim->GetPageId().GetFileId()];
-          if(file){
-            file->FlushPage(victim->GetPageId(), victim->page_data);
-          }
-        }
-        page_map.erase(victim->GetPageId());
-        delete victim; 
-        evicted = true;
-        break;
+      // The cleaner fell behind; the caller writes the page back
+      if (victim->IsDirty()) {
+        PinForWriteback(victim);
+        *out_dirty = victim;
+        return nullptr;
       }
+      page_table->Remove(victim);
     }
+    sc->replacer->Remove(slot);
+    victim->page_id = PageId();
+    victim->readahead_trigger = false;
+    return victim;
+  }
+}
 
-    if (!evicted && page_map.size() >= page_count) {
+Page *BufferManager::PinIfBuffered(PageId page_id) {
+  Page *page = nullptr;
+  {
+    PageTable::Partition &part = page_table->GetPartition(page_id);
+    std::lock_guard<std::mutex> part_lock(part.latch);
+    page = page_table->Find(page_id);
+    if (!page) {
       return nullptr;
     }
+    page->IncPinCount();
   }
+  // Pinned, so the frame cannot be evicted under us
+  SizeClass &sc = size_classes[page->size_class];
+  sc.replacer->RecordAccess(sc.Slot(page));
+  return page;
+}
 
-  // Allocate new page
-  Page* new_page = new Page();
-  new_page->page_id = page_id;
-  new_page->IncPinCount();
-  page_map[page_id] = new_page;
+bool BufferManager::WaitForIo(Page *page) {
+  if (page->io_state.load() == Page::kIoDone) {
+    return true;
+  }
 
-  BaseFile* file = file_map[new_page->GetPageId().GetFileId()];
-  if (file) {
-    if (!file->LoadPage(page_id, new_page->page_data)) {
-      lru.remove(new_page);     
-      page_map.erase(page_id);
-      delete new_page;
-      return nullptr;
+  IoWait &wait = io_waits[page->frame_id % kIoWaitStripes];
+  std::unique_lock<std::mutex> lock(wait.latch);
+  wait.cv.wait(lock, [page]() { return page->io_state.load() != Page::kIoReading; });
+  if (page->io_state.load() == Page::kIoFailed) {
+    // The loader is waiting for all pinners to leave before freeing the frame
+    page->DecPinCount();
+    wait.cv.notify_all();
+    return false;
+  }
+  return true;
+}
+
+void BufferManager::FinishLoad(Page *page, bool success) {
+  IoWait &wait = io_waits[page->frame_id % kIoWaitStripes];
+  if (success) {
+    {
+      std::lock_guard<std::mutex> lock(wait.latch);
+      page->io_state = Page::kIoDone;
     }
-  } else {
-    lru.remove(new_page);
-    page_map.erase(page_id);
-    delete new_page;
+    wait.cv.notify_all();
+    return;
+  }
+
+  // Unhook the frame so no new pinners arrive, fail the ones that are waiting
+  // and free the frame once they are gone
+  {
+    PageTable::Partition &part = page_table->GetPartition(page->GetPageId());
+    std::lock_guard<std::mutex> part_lock(part.latch);
+    page_table->Remove(page);
+  }
+  SizeClass &sc = size_classes[page->size_class];
+  sc.replacer->Remove(sc.Slot(page));
+  {
+    std::unique_lock<std::mutex> lock(wait.latch);
+    page->io_state = Page::kIoFailed;
+    wait.cv.notify_all();
+    wait.cv.wait(lock, [page]() { return page->GetPinCount() == 1; });
+    page->io_state = Page::kIoDone;
+  }
+
+  std::lock_guard<std::mutex> lock(buffer_mutex);
+  page->pin_count = 0;
+  page->page_id = PageId();
+  page->readahead_trigger = false;
+  sc.free_frames.push_back(page->frame_id);
+}
+
+Page* BufferManager::PinPage(PageId page_id) {
+  if (!page_id.IsValid()) {
     return nullptr;
   }
 
-  lru.push_back(new_page);
-  return new_page;
+  // Hit path: only the page's partition latch is taken
+  Page *page = PinIfBuffered(page_id);
+  if (page) {
+    if (!WaitForIo(page)) {
+      return nullptr;
+    }
+    // A sequential reader reached a read-ahead window; read the next one
+    if (page->readahead_trigger.load(std::memory_order_relaxed) &&
+        page->readahead_trigger.exchange(false)) {
+      std::shared_lock<std::shared_mutex> io_lock(io_latch);
+      std::lock_guard<std::mutex> lock(buffer_mutex);
+      auto file_it = file_map.find(page_id.GetFileId());
+      if (file_it != file_map.end()) {
+        ReadAheadLocked(file_it->second, page_id, false);
+      }
+    }
+    return page;
+  }
+
+  // Keep files from being unregistered while we do I/O without buffer_mutex
+  std::shared_lock<std::shared_mutex> io_lock(io_latch);
+  BaseFile *file = nullptr;
+  while (true) {
+    std::unique_lock<std::mutex> lock(buffer_mutex);
+
+    // Another thread may have started loading the page while we waited;
+    // misses are serialized by buffer_mutex, so the page cannot appear after
+    // this check
+    page = PinIfBuffered(page_id);
+    if (page) {
+      lock.unlock();
+      return WaitForIo(page) ? page : nullptr;
+    }
+
+    auto file_it = file_map.find(page_id.GetFileId());
+    if (file_it == file_map.end()) {
+      return nullptr;
+    }
+    file = file_it->second;
+    SizeClass *sc = GetSizeClass(file->GetPageSize());
+
+    Page *dirty = nullptr;
+    uint64_t releases = GetWritebackReleases();
+    page = GetVictimFrame(sc, &dirty);
+    if (page) {
+      // Publish the frame in the I/O-in-progress state: concurrent pinners
+      // of this page wait on the frame, everybody else carries on
+      ++miss_count;
+      page->page_id = page_id;
+      page->free_slot_hint = 0;
+      page->readahead_trigger = false;
+      page->pin_count = 1;
+      page->io_state = Page::kIoReading;
+      sc->replacer->RecordLoad(sc->Slot(page));
+      PageTable::Partition &part = page_table->GetPartition(page_id);
+      {
+        std::lock_guard<std::mutex> part_lock(part.latch);
+        page_table->Insert(page);
+      }
+      ReadAheadLocked(file, page_id, true);
+      break;
+    }
+    if (!dirty) {
+      // Frames reserved for prefetching come free once their reads are
+      // done, frames pinned for write-back once they are written; otherwise
+      // everything is pinned for good
+      lock.unlock();
+      if (!DrainPrefetches() && !WaitForWriteback(releases)) {
+        return nullptr;
+      }
+      continue;
+    }
+
+    // Write the dirty victim back outside buffer_mutex, then try again
+    auto victim_it = file_map.find(dirty->GetPageId().GetFileId());
+    BaseFile *victim_file = victim_it == file_map.end() ? nullptr : victim_it->second;
+    ++victim_flush_count;
+    lock.unlock();
+    cleaner_cv.notify_one();
+    if (victim_file) {
+      FlushFrame(victim_file, dirty);
+    } else {
+      dirty->SetDirty(false);
+    }
+    UnpinWriteback(dirty);
+  }
+
+  bool success = file->LoadPage(page_id, page->page_data);
+  FinishLoad(page, success);
+  return success ? page : nullptr;
 }
 
 void BufferManager::UnpinPage(Page *page) {
   // 1. Unpin the provided page by decrementing the pin count. The page should stay in the buffer
   //    pool until another operation evicts it later.
-  // 2. The page should be added to the LRU queue when its pin count becomes 0.
+  // 2. The page becomes an eviction candidate once its pin count drops to 0; the replacer skips
+  //    pinned frames, so there is nothing to update here.
   if(!page) {
     return;
   }
-  std::lock_guard<std::mutex> lock(buffer_mutex);
 
   page->DecPinCount();
-  if (page->GetPinCount() == 0 ) {
-    std::lock_guard<std::mutex> lru_lock(lru_mutex);
-    
-    if (std::find(lru.begin(), lru.end(), page) == lru.end()) {
-      lru.push_back(page);
-    }
-  }
 }
 
 void BufferManager::RegisterFile(BaseFile *bf) {
@@ -141,7 +414,457 @@ void BufferManager::RegisterFile(BaseFile *bf) {
   }
 
   std::lock_guard<std::mutex> lock(buffer_mutex);
+  LOG_IF(FATAL, !GetSizeClass(bf->GetPageSize()))
+      << "No buffer frames for page size " << bf->GetPageSize();
   file_map[bf->GetId()] = bf;
+  read_ahead[bf->GetId()] = ReadAhead();
+}
+
+void BufferManager::UnregisterFile(BaseFile *bf) {
+  if(!bf) {
+    return;
+  }
+
+  // Wait for reads and write-backs running outside buffer_mutex
+  DrainPrefetches();
+  std::unique_lock<std::shared_mutex> io_lock(io_latch);
+  std::lock_guard<std::mutex> lock(buffer_mutex);
+  for (uint32_t i = 0; i < page_count; ++i) {
+    Page *page = &page_frames[i];
+    if (!page->GetPageId().IsValid() || (int)page->GetPageId().GetFileId() != bf->GetId()) {
+      continue;
+    }
+    LOG_IF(FATAL, page->GetPinCount() > 0) << "Unregistering a file with pinned pages";
+    if (page->IsDirty()) {
+      FlushFrame(bf, page);
+      page->SetDirty(false);
+    }
+    {
+      PageTable::Partition &part = page_table->GetPartition(page->GetPageId());
+      std::lock_guard<std::mutex> part_lock(part.latch);
+      page_table->Remove(page);
+    }
+    SizeClass &sc = size_classes[page->size_class];
+    sc.replacer->Remove(sc.Slot(page));
+    page->page_id = PageId();
+    page->readahead_trigger = false;
+    sc.free_frames.push_back(page->frame_id);
+  }
+  file_map.erase(bf->GetId());
+  read_ahead.erase(bf->GetId());
+}
+
+bool BufferManager::EvictPage(PageId page_id) {
+  // Write-back pins are dropped once the write is done, so only pins of
+  // callers make the eviction fail
+  while (true) {
+    uint64_t releases = GetWritebackReleases();
+    bool pinned = false;
+    if (TryEvictPage(page_id, &pinned)) {
+      return true;
+    }
+    if (!pinned || !WaitForWriteback(releases)) {
+      return false;
+    }
+  }
+}
+
+bool BufferManager::TryEvictPage(PageId page_id, bool *pinned) {
+  // Pin the page first, so that it stays put while it is written back; a
+  // failed read frees the frame itself
+  std::shared_lock<std::shared_mutex> io_lock(io_latch);
+  Page *page = PinIfBuffered(page_id);
+  if (!page) {
+    return true;
+  }
+  if (!WaitForIo(page)) {
+    return true;
+  }
+
+  BaseFile *file = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(buffer_mutex);
+    auto file_it = file_map.find(page_id.GetFileId());
+    if (file_it != file_map.end()) {
+      file = file_it->second;
+    }
+  }
+  if (page->IsDirty() && (!file || !FlushFrame(file, page))) {
+    UnpinPage(page);
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(buffer_mutex);
+  SizeClass &sc = size_classes[page->size_class];
+  {
+    PageTable::Partition &part = page_table->GetPartition(page_id);
+    std::lock_guard<std::mutex> part_lock(part.latch);
+    if (page->GetPinCount() > 1 || page->IsDirty()) {
+      page->DecPinCount();
+      *pinned = true;
+      return false;
+    }
+    page_table->Remove(page);
+  }
+  sc.replacer->Remove(sc.Slot(page));
+  page->pin_count = 0;
+  page->page_id = PageId();
+  page->readahead_trigger = false;
+  sc.free_frames.push_back(page->frame_id);
+  return true;
+}
+
+uint32_t BufferManager::Prefetch(PageId first, uint32_t count) {
+  if (!first.IsValid()) {
+    return 0;
+  }
+
+  std::shared_lock<std::shared_mutex> io_lock(io_latch);
+  std::lock_guard<std::mutex> lock(buffer_mutex);
+  auto file_it = file_map.find(first.GetFileId());
+  if (file_it == file_map.end()) {
+    return 0;
+  }
+  return PrefetchLocked(file_it->second, first, count, false);
+}
+
+uint32_t BufferManager::PrefetchLocked(BaseFile *file, PageId first, uint32_t count,
+                                       bool trigger) {
+  uint32_t end = std::min<uint64_t>((uint64_t)first.GetPageNum() + count, file->GetPageCount());
+  SizeClass *sc = GetSizeClass(file->GetPageSize());
+  uint32_t issued = 0;
+  IoRequest *batch[kPrefetchBatchSize];
+  uint32_t nbatch = 0;
+  for (uint32_t page_num = first.GetPageNum(); page_num < end; ++page_num) {
+    PageId pid(first.GetFileId(), page_num);
+    PageTable::Partition &part = page_table->GetPartition(pid);
+    {
+      std::lock_guard<std::mutex> part_lock(part.latch);
+      if (page_table->Find(pid)) {
+        continue;
+      }
+    }
+
+    // Prefetching is only worth it with a clean frame at hand; never write
+    // back a dirty victim for it
+    Page *dirty = nullptr;
+    Page *page = GetVictimFrame(sc, &dirty);
+    if (!page) {
+      if (dirty) {
+        UnpinWriteback(dirty);
+      }
+      break;
+    }
+
+    // Reserve the frame like a miss would; the pin is held until the read
+    // completes
+    page->page_id = pid;
+    page->free_slot_hint = 0;
+    page->pin_count = 1;
+    page->io_state = Page::kIoReading;
+    page->readahead_trigger = trigger && issued == 0;
+    sc->replacer->RecordLoad(sc->Slot(page));
+    {
+      std::lock_guard<std::mutex> part_lock(part.latch);
+      page_table->Insert(page);
+    }
+    IoRequest *req = &frame_io[page->frame_id];
+    file->PrepareLoad(req, pid, page->page_data);
+    req->callback = PrefetchDone;
+    req->arg = this;
+    batch[nbatch++] = req;
+    ++issued;
+
+    if (nbatch == kPrefetchBatchSize) {
+      {
+        std::lock_guard<std::mutex> lock(prefetch_mutex);
+        prefetch_in_flight += nbatch;
+      }
+      io_engine->Submit(batch, nbatch);
+      nbatch = 0;
+    }
+  }
+  if (nbatch) {
+    {
+      std::lock_guard<std::mutex> lock(prefetch_mutex);
+      prefetch_in_flight += nbatch;
+    }
+    io_engine->Submit(batch, nbatch);
+  }
+  return issued;
+}
+
+void BufferManager::SetReadAheadPages(uint32_t pages) {
+  std::lock_guard<std::mutex> lock(buffer_mutex);
+  read_ahead_pages = std::min(pages, page_count);
+}
+
+void BufferManager::ReadAheadLocked(BaseFile *file, PageId pid, bool miss) {
+  // Like for the whole pool, a window takes at most a quarter of the class
+  uint32_t window = std::min(read_ahead_pages, GetSizeClass(file->GetPageSize())->frame_count / 4);
+  if (window == 0) {
+    return;
+  }
+  auto it = read_ahead.find(pid.GetFileId());
+  if (it == read_ahead.end()) {
+    return;
+  }
+
+  ReadAhead &ra = it->second;
+  uint32_t page_num = pid.GetPageNum();
+  if (miss) {
+    ra.run = page_num == ra.next_page ? ra.run + 1 : 1;
+    if (ra.run < kReadAheadTrigger) {
+      ra.next_page = page_num + 1;
+      return;
+    }
+  }
+  ra.next_page = page_num + 1;
+
+  // Don't pile up windows while the reads are behind
+  {
+    std::lock_guard<std::mutex> lock(prefetch_mutex);
+    if (prefetch_in_flight >= window) {
+      return;
+    }
+  }
+
+  // Skip what earlier windows already cover
+  uint32_t start = page_num + 1;
+  if (ra.window_end > start && ra.window_end <= start + window) {
+    start = ra.window_end;
+  }
+  PrefetchLocked(file, PageId(pid.GetFileId(), start), window, true);
+  ra.window_end = start + window;
+}
+
+bool BufferManager::DrainPrefetches() {
+  std::unique_lock<std::mutex> lock(prefetch_mutex);
+  if (prefetch_in_flight == 0) {
+    return false;
+  }
+  prefetch_cv.wait(lock, [this]() { return prefetch_in_flight == 0; });
+  return true;
+}
+
+void BufferManager::PrefetchDone(IoRequest *req) {
+  BufferManager *bm = (BufferManager *)req->arg;
+  Page *page = &bm->page_frames[req - bm->frame_io.data()];
+
+  // Pinners that arrived meanwhile wait in WaitForIo; on failure FinishLoad
+  // frees the frame along with our pin
+  bool success = req->Succeeded();
+  bm->FinishLoad(page, success);
+  if (success) {
+    bm->UnpinPage(page);
+  }
+
+  std::lock_guard<std::mutex> lock(bm->prefetch_mutex);
+  if (--bm->prefetch_in_flight == 0) {
+    bm->prefetch_cv.notify_all();
+  }
+}
+
+bool BufferManager::FlushFrame(BaseFile *file, Page *page) {
+  // Clear the dirty bit before writing, so that a concurrent update that
+  // dirties the page again is not lost
+  page->Lock();
+  page->SetDirty(false);
+  bool success = file->FlushPage(page->GetPageId(), page->page_data);
+  if (!success) {
+    page->SetDirty(true);
+  }
+  page->Unlock();
+  return success;
+}
+
+bool BufferManager::Checkpoint() {
+  // Write-ahead logging: the log records describing the pages go first
+  LogManager *log = LogManager::Get();
+  if (log && !log->Flush()) {
+    return false;
+  }
+
+  std::shared_lock<std::shared_mutex> io_lock(io_latch);
+  bool success = true;
+  for (uint32_t i = 0; i < page_count; ++i) {
+    Page *page = &page_frames[i];
+    if (!page->IsDirty()) {
+      continue;
+    }
+
+    // Pin the page so it stays put while being written back. Frames still
+    // being read are skipped: a failed read waits for its pinners to leave,
+    // and the pin here would not tell it. Misses are serialized by
+    // buffer_mutex, so a loaded frame cannot start a read meanwhile.
+    BaseFile *file = nullptr;
+    {
+      std::lock_guard<std::mutex> lock(buffer_mutex);
+      auto it = file_map.find(page->GetPageId().GetFileId());
+      if (!page->GetPageId().IsValid() || it == file_map.end() ||
+          page->io_state.load() != Page::kIoDone) {
+        continue;
+      }
+      PageTable::Partition &part = page_table->GetPartition(page->GetPageId());
+      std::lock_guard<std::mutex> part_lock(part.latch);
+      PinForWriteback(page);
+      file = it->second;
+    }
+    if (page->IsDirty()) {
+      success = FlushFrame(file, page) && success;
+    }
+    UnpinWriteback(page);
+  }
+
+  // Sync without buffer_mutex; io_latch keeps the files open
+  std::vector<BaseFile *> files;
+  {
+    std::lock_guard<std::mutex> lock(buffer_mutex);
+    for (auto &f : file_map) {
+      files.push_back(f.second);
+    }
+  }
+  for (auto file : files) {
+    success = file->Sync() && success;
+  }
+  return success;
+}
+
+void BufferManager::SetDirtyWatermarks(double low, double high) {
+  LOG_IF(FATAL, low < 0 || low > high || high > 1) << "Invalid dirty page watermarks";
+  {
+    std::lock_guard<std::mutex> lock(cleaner_mutex);
+    dirty_low_watermark = low;
+    dirty_high_watermark = high;
+  }
+  cleaner_cv.notify_one();
+}
+
+uint32_t BufferManager::CleanBatch(uint32_t max_pages) {
+  std::shared_lock<std::shared_mutex> io_lock(io_latch);
+  Page *pages[kCleanerBatchSize];
+  BaseFile *files[kCleanerBatchSize];
+  uint32_t npages = 0;
+  max_pages = std::min(max_pages, kCleanerBatchSize);
+
+  // Pick and pin the pages under buffer_mutex, so they cannot be evicted or
+  // dropped, but write them back without it
+  {
+    std::lock_guard<std::mutex> lock(buffer_mutex);
+    for (uint32_t i = 0; i < page_count && npages < max_pages; ++i) {
+      Page *page = &page_frames[cleaner_cursor];
+      cleaner_cursor = (cleaner_cursor + 1) % page_count;
+      if (!page->IsDirty() || page->GetPinCount() > 0) {
+        continue;
+      }
+      auto it = file_map.find(page->GetPageId().GetFileId());
+      if (it == file_map.end()) {
+        continue;
+      }
+
+      // Leave pages alone that someone pinned (and may be updating)
+      PageTable::Partition &part = page_table->GetPartition(page->GetPageId());
+      std::lock_guard<std::mutex> part_lock(part.latch);
+      if (page->GetPinCount() > 0) {
+        continue;
+      }
+      PinForWriteback(page);
+      pages[npages] = page;
+      files[npages] = it->second;
+      ++npages;
+    }
+  }
+
+  // Write the batch back with a single submission. Like in FlushFrame, the
+  // dirty bits are cleared first so concurrent updates are not lost.
+  // Waiting for a latch while holding others could deadlock with a user
+  // holding a data page latch and waiting for its directory page, so pages
+  // latched by someone (who pinned them since) are left for later.
+  IoRequest *reqs[kCleanerBatchSize];
+  uint32_t nlatched = 0;
+  for (uint32_t i = 0; i < npages; ++i) {
+    if (!pages[i]->TryLock()) {
+      UnpinWriteback(pages[i]);
+      continue;
+    }
+    pages[nlatched] = pages[i];
+    files[nlatched] = files[i];
+    ++nlatched;
+  }
+  npages = nlatched;
+  for (uint32_t i = 0; i < npages; ++i) {
+    pages[i]->SetDirty(false);
+    reqs[i] = &frame_io[pages[i]->frame_id];
+    files[i]->PrepareFlush(reqs[i], pages[i]->GetPageId(), pages[i]->page_data);
+  }
+  uint32_t written = io_engine->SubmitAndWait(reqs, npages);
+  for (uint32_t i = 0; i < npages; ++i) {
+    if (!reqs[i]->Succeeded()) {
+      pages[i]->SetDirty(true);
+    }
+    pages[i]->Unlock();
+    UnpinWriteback(pages[i]);
+  }
+  return written;
+}
+
+void BufferManager::PinForWriteback(Page *page) {
+  {
+    std::lock_guard<std::mutex> lock(writeback_mutex);
+    ++writeback_pins;
+  }
+  page->IncPinCount();
+}
+
+void BufferManager::UnpinWriteback(Page *page) {
+  UnpinPage(page);
+  {
+    std::lock_guard<std::mutex> lock(writeback_mutex);
+    --writeback_pins;
+    ++writeback_releases;
+  }
+  writeback_cv.notify_all();
+}
+
+uint64_t BufferManager::GetWritebackReleases() {
+  std::lock_guard<std::mutex> lock(writeback_mutex);
+  return writeback_releases;
+}
+
+bool BufferManager::WaitForWriteback(uint64_t releases) {
+  std::unique_lock<std::mutex> lock(writeback_mutex);
+  if (writeback_pins == 0 && writeback_releases == releases) {
+    return false;
+  }
+  writeback_cv.wait(lock, [this, releases]() { return writeback_releases != releases; });
+  return true;
+}
+
+void BufferManager::CleanerLoop() {
+  std::unique_lock<std::mutex> lock(cleaner_mutex);
+  while (!cleaner_stop) {
+    cleaner_cv.wait_for(lock, std::chrono::milliseconds(kCleanerIntervalMs));
+    if (cleaner_stop) {
+      break;
+    }
+    uint32_t low = dirty_low_watermark * page_count;
+    uint32_t high = dirty_high_watermark * page_count;
+    lock.unlock();
+
+    // Pinned dirty pages count too; once only those are left, a batch
+    // writes nothing and the cleaner waits for the next round
+    uint32_t dirty = dirty_count.load(std::memory_order_relaxed);
+    if (dirty > high) {
+      while (dirty > low) {
+        uint32_t written = CleanBatch(dirty - low);
+        if (written == 0) {
+          break;
+        }
+        dirty = dirty_count.load(std::memory_order_relaxed);
+      }
+    }
+    lock.lock();
+  }
 }
 
 }  // namespace yase
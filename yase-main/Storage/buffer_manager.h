@@ -14,68 +14,294 @@
 #include <memory>
 #include <map>
 #include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <condition_variable>
+#include <vector>
 
 #include <gtest/gtest_prod.h>
 
 #include "file.h"
 #include "page.h"
+#include "replacer.h"
 
 namespace yase {
 
 struct BufferManager;
 
-// Representation of a page in memory. The buffer has an array of Pages to
-// accommodate DataPages and DirectoryPages.
+// Representation of a page frame in memory. The buffer has an array of Pages
+// (frame descriptors) to accommodate DataPages and DirectoryPages; the page
+// contents live in separate frames owned by the buffer manager, so the
+// descriptors stay small and the data stays page-aligned. Each frame belongs
+// to a size class and only holds pages of that class's size.
 struct Page {
-  // Whether the page is dirty
-  bool is_dirty;
+  // Marks an unused frame index (e.g., the end of a hash chain)
+  static constexpr uint32_t kInvalidFrame = ~uint32_t{0};
 
-  // Pin count - the number of users of this page
-  uint16_t pin_count;
+  // States of the page data while it is read from storage
+  static constexpr uint8_t kIoDone = 0;     // Page data is valid (or frame unused)
+  static constexpr uint8_t kIoReading = 1;  // Read in progress
+  static constexpr uint8_t kIoFailed = 2;   // Read failed, frame is being freed
+
+  // Whether the page is dirty; read without latches by the page cleaner
+  std::atomic<bool> is_dirty;
+
+  // Number of dirty frames in the buffer pool, kept up to date by SetDirty;
+  // nullptr for frames outside a buffer pool
+  std::atomic<uint32_t> *dirty_count;
+
+  // One of the kIo* states
+  std::atomic<uint8_t> io_state;
+
+  // Set on the first page of a read-ahead window; pinning it starts reading
+  // the next window
+  std::atomic<bool> readahead_trigger;
+
+  // Pin count - the number of users of this page. Pinning happens under the
+  // page table partition latch, unpinning is latch-free.
+  std::atomic<uint16_t> pin_count;
 
   // ID of the page held in page_data
   PageId page_id;
 
-  // Space to hold a real page loaded from storage
-  char page_data[PAGE_SIZE];
+  // Space to hold a real page loaded from storage; points to this frame's
+  // slot in BufferManager::frame_data
+  char *page_data;
+
+  // Index of this frame in BufferManager::page_frames
+  uint32_t frame_id;
+
+  // Next frame in the same page table hash chain
+  uint32_t hash_next;
+
+  // Index of the frame's size class in BufferManager::size_classes
+  uint8_t size_class;
+
+  // For data pages: slots below this one are likely occupied, so slot
+  // searches start here (see DataPageT::Insert). Kept by the page's users
+  // under the page latch; reset when a page is loaded into the frame.
+  uint16_t free_slot_hint;
 
   //mutex for page protection
   std::mutex page_mutex;
 
-  Page() : is_dirty(false), pin_count(0) {}
+  Page() : is_dirty(false), dirty_count(nullptr), io_state(kIoDone), readahead_trigger(false), pin_count(0),
+           page_data(nullptr), frame_id(kInvalidFrame), hash_next(kInvalidFrame),
+           size_class(0), free_slot_hint(0) {}
   ~Page() {}
 
-  // Helper functions
+  // Helper functions; GetDataPage is only valid for PAGE_SIZE pages, see
+  // VisitDataPage for the others
   inline DataPage *GetDataPage() { return (DataPage *)page_data; }
   inline DirectoryPage *GetDirPage() { return (DirectoryPage *)page_data; }
-  inline void SetDirty(bool dirty) { is_dirty = dirty; }
+  inline void SetDirty(bool dirty) {
+    if (is_dirty.exchange(dirty) != dirty && dirty_count) {
+      if (dirty) {
+        dirty_count->fetch_add(1, std::memory_order_relaxed);
+      } else {
+        dirty_count->fetch_sub(1, std::memory_order_relaxed);
+      }
+    }
+  }
   inline PageId GetPageId() { return page_id; }
   inline void IncPinCount() { pin_count += 1; }
-  inline void DecPinCount() { pin_count -= 1; }
+  // Returns the pin count after unpinning
+  inline uint16_t DecPinCount() { return pin_count.fetch_sub(1) - 1; }
   inline bool IsDirty() { return is_dirty; }
   inline uint16_t GetPinCount() { return pin_count; }
 
   inline void Lock() { page_mutex.lock(); }
+  inline bool TryLock() { return page_mutex.try_lock(); }
   inline void Unlock() { page_mutex.unlock(); }
 };
 
+// Hash table mapping page IDs to the frames that hold them. The table is
+// split into partitions, each protected by its own latch, so pins of pages
+// in different partitions never contend with each other.
+struct PageTable {
+  static constexpr uint32_t kPartitionCount = 64;
+
+  struct alignas(64) Partition {
+    // Latch protecting the hash chains of this partition
+    std::mutex latch;
+
+    // Head frame of each hash chain; chains are linked through Page::hash_next
+    std::vector<uint32_t> buckets;
+  };
+
+  // @frames: the buffer pool's frame descriptors
+  // @frame_count: number of frames
+  PageTable(Page *frames, uint32_t frame_count);
+
+  inline static uint64_t Hash(PageId pid) { return (pid.value * 0x9e3779b97f4a7c15ULL) >> 16; }
+  inline Partition &GetPartition(PageId pid) {
+    return partitions[Hash(pid) % kPartitionCount];
+  }
+
+  // Look up, add and remove frames; the caller must hold the latch of the
+  // page's partition
+  Page *Find(PageId pid);
+  void Insert(Page *page);
+  void Remove(Page *page);
+
+  inline uint32_t &GetBucket(PageId pid) {
+    Partition &part = GetPartition(pid);
+    return part.buckets[(Hash(pid) / kPartitionCount) % part.buckets.size()];
+  }
+
+  Page *frames;
+  Partition partitions[kPartitionCount];
+};
+
 struct BufferManager {
   
   
   static BufferManager *instance;
 
-  //Mutex to pretect buffer operations
+  // Mutex serializing buffer misses and evictions; hits never take it
   std::mutex buffer_mutex;
 
-  //Protect LRU
-  std::mutex lru_mutex;
-  std::list<Page *> lru;
+  // Frames of one page size for the buffer pool to have
+  struct SizeClassConfig {
+    uint32_t page_size;
+    uint32_t frame_count;
+  };
+
+  // A contiguous range of frames holding pages of one size. Pages of a file
+  // only go to the frames of the class matching the file's page size, and
+  // each class has its own replacer, so classes never evict each other's
+  // pages.
+  struct SizeClass {
+    uint32_t page_size;
+
+    // Frames [first_frame, first_frame + frame_count) of page_frames
+    uint32_t first_frame;
+    uint32_t frame_count;
+
+    // Chooses eviction victims among the unpinned frames of the class; it
+    // numbers the frames from 0
+    Replacer *replacer;
+
+    // Indices (in page_frames) of frames that hold no page; reserved up
+    // front so that taking or returning a frame never allocates. Protected
+    // by buffer_mutex.
+    std::vector<uint32_t> free_frames;
+
+    // Index of [page] among the frames of this class
+    inline uint32_t Slot(Page *page) { return page->frame_id - first_frame; }
+  };
+
+  // Size classes; directory pages need the PAGE_SIZE class
+  std::vector<SizeClass> size_classes;
+
+  // Number of PinPage calls that had to load the page from storage; protected
+  // by buffer_mutex
+  uint64_t miss_count;
+
+  // Number of dirty victims written back by PinPage itself (i.e., not by the
+  // page cleaner); protected by buffer_mutex
+  uint64_t victim_flush_count;
+
+  // Held shared while pages are read or written back outside buffer_mutex,
+  // and exclusively by UnregisterFile so that a BaseFile is never closed
+  // under such I/O
+  std::shared_mutex io_latch;
+
+  // Pinners of a frame whose page is still being read wait here; frames are
+  // striped over a few condition variables
+  static constexpr uint32_t kIoWaitStripes = 64;
+  struct IoWait {
+    std::mutex latch;
+    std::condition_variable cv;
+  };
+  IoWait io_waits[kIoWaitStripes];
+
+  // Background page cleaner: when more than dirty_high_watermark of the
+  // frames hold dirty unpinned pages, it writes them back until at most
+  // dirty_low_watermark of the frames are dirty, so that evictions almost
+  // always find a clean victim
+  static constexpr uint32_t kCleanerIntervalMs = 10;
+  static constexpr uint32_t kCleanerBatchSize = 32;
+  std::thread cleaner;
+  std::mutex cleaner_mutex;
+  std::condition_variable cleaner_cv;
+  bool cleaner_stop;
+  double dirty_low_watermark;
+  double dirty_high_watermark;
+
+  // Next frame the cleaner looks at
+  uint32_t cleaner_cursor;
+
+  // Number of frames holding a dirty page, pinned or not; compared against
+  // the watermarks, so the cleaner doesn't look at every frame while idle
+  std::atomic<uint32_t> dirty_count;
+
+  // Frames the buffer manager pinned itself to write them back (cleaner
+  // batches, dirty victims and checkpoints). They are only briefly unavailable, so a miss
+  // that finds no victim waits for them instead of failing. Protected by
+  // writeback_mutex; writeback_releases counts the pins dropped so far.
+  std::mutex writeback_mutex;
+  std::condition_variable writeback_cv;
+  uint32_t writeback_pins;
+  uint64_t writeback_releases;
+
+  // Asynchronous I/O for prefetching and write-back; the frames are
+  // registered with it
+  IoEngine *io_engine;
+
+  // I/O request of each frame; a frame has at most one request in flight
+  std::vector<IoRequest> frame_io;
+
+  // Prefetch reads are submitted in batches of up to this many
+  static constexpr uint32_t kPrefetchBatchSize = 32;
 
-  inline static void Initialize(uint32_t page_count) {
-    BufferManager::instance = new BufferManager(page_count);
+  // Number of prefetch reads in flight; protected by prefetch_mutex
+  std::mutex prefetch_mutex;
+  std::condition_variable prefetch_cv;
+  uint32_t prefetch_in_flight;
+
+  // Sequential read-ahead: after kReadAheadTrigger consecutive misses on a
+  // file, the following read_ahead_pages pages are prefetched; pinning the
+  // first page of such a window prefetches the next one
+  static constexpr uint32_t kReadAheadTrigger = 2;
+  static constexpr uint32_t kReadAheadPages = 8;
+  uint32_t read_ahead_pages;  // protected by buffer_mutex
+  struct ReadAhead {
+    // Page expected next if the access is sequential
+    uint32_t next_page;
+
+    // Length of the current run of sequential misses
+    uint32_t run;
+
+    // Pages before this have been prefetched already
+    uint32_t window_end;
+
+    ReadAhead() : next_page(0), run(0), window_end(0) {}
+  };
+
+  // File ID - read-ahead state mapping; protected by buffer_mutex
+  std::map<int, ReadAhead> read_ahead;
+
+  // @page_count: number of pages in the buffer pool
+  // @policy: page replacement policy
+  // @backend: asynchronous I/O backend
+  inline static void Initialize(uint32_t page_count,
+                                Replacer::Policy policy = Replacer::Policy::Clock,
+                                IoEngine::Backend backend = IoEngine::Auto) {
+    BufferManager::instance = new BufferManager(page_count, policy, backend);
+  }
+
+  // @classes: frames to have for each page size used by the files
+  // @policy: page replacement policy
+  // @backend: asynchronous I/O backend
+  inline static void Initialize(const std::vector<SizeClassConfig> &classes,
+                                Replacer::Policy policy = Replacer::Policy::Clock,
+                                IoEngine::Backend backend = IoEngine::Auto) {
+    BufferManager::instance = new BufferManager(classes, policy, backend);
   }
   inline static void Uninitialize() {
     delete BufferManager::instance;
+    BufferManager::instance = nullptr;
   }
   inline static BufferManager *Get() { return instance; }
 
@@ -92,25 +318,152 @@ struct BufferManager {
   // @page: Page to unpin
   void UnpinPage(Page *page);
 
-  // Add the file ID - BaseFile* mappings to support multiple tables
+  // Add the file ID - BaseFile* mappings to support multiple tables; the
+  // buffer pool must have a size class for the file's page size
   // @file: pointer to the File object
   void RegisterFile(BaseFile *bf);
 
+  // Start asynchronous reads of pages [first, first + count) of a file into
+  // unpinned frames; pages already buffered are skipped, and the range is
+  // cut off at the end of the file
+  // @first: ID of the first page
+  // @count: number of pages
+  // Returns the number of reads issued, which is smaller than requested if
+  // no clean unpinned frames are left
+  uint32_t Prefetch(PageId first, uint32_t count);
+
+  // Write back all dirty pages and make them durable: the log is flushed
+  // first (if there is one), then the pages are written and every file is
+  // synced. Returns true/false if succeeded/failed.
+  bool Checkpoint();
+
+  // Set the size of sequential read-ahead windows; 0 turns read-ahead off
+  void SetReadAheadPages(uint32_t pages);
+
+  // Set the page cleaner's watermarks, as fractions of the buffer pool size
+  // @low: the cleaner stops once at most this fraction of frames is dirty
+  // @high: the cleaner starts once more than this fraction of frames is dirty
+  void SetDirtyWatermarks(double low, double high);
+
+  // Write back the page if it is dirty and drop it from the buffer pool, so
+  // the next pin reads it from storage; write-backs holding the page are
+  // waited for
+  // @page_id: ID of the page to evict
+  // Returns true if the page is not buffered anymore; false if it is pinned
+  // or can't be written back
+  bool EvictPage(PageId page_id);
+
+  // Write back and drop all buffered pages of a file, and remove its mapping;
+  // must be called before the BaseFile is destroyed
+  // @file: pointer to the File object
+  void UnregisterFile(BaseFile *bf);
+
   // Buffer manager constructor
-  // @page_count: number of pages in the buffer pool
-  BufferManager(uint32_t page_count);
+  // @page_count: number of pages in the buffer pool, all of PAGE_SIZE
+  // @policy: page replacement policy
+  // @backend: asynchronous I/O backend
+  BufferManager(uint32_t page_count, Replacer::Policy policy = Replacer::Policy::Clock,
+                IoEngine::Backend backend = IoEngine::Auto);
+
+  // Buffer manager with a size class for each of [classes]; one of them
+  // must be for PAGE_SIZE
+  BufferManager(const std::vector<SizeClassConfig> &classes,
+                Replacer::Policy policy = Replacer::Policy::Clock,
+                IoEngine::Backend backend = IoEngine::Auto);
   ~BufferManager();
 
   // File ID - BaseFile* mapping
   std::map<int, BaseFile*> file_map;
 
   // Page ID - Page frame mapping
-  std::map<PageId, Page*, PageId> page_map;
+  PageTable *page_table;
 
-  // Number of page frames
+  // Number of page frames, over all size classes
   uint32_t page_count;
 
-  // An array of buffer pages
+  // An array of buffer pages (frame descriptors)
   Page *page_frames;
+
+  // Page contents; each size class has a run of frames of its page size,
+  // starting at a multiple of the page size. The region is mapped
+  // separately, backed by huge pages if possible, and page-aligned as direct
+  // I/O requires.
+  static constexpr size_t kHugePageSize = 2 * 1024 * 1024;
+  char *frame_data;
+  size_t frame_data_len;
+
+  // Return the size class of [page_size], nullptr if there is none
+  SizeClass *GetSizeClass(uint32_t page_size);
+
+  // Find a frame of class [sc] for a new page: a free frame if there is one,
+  // otherwise the unpinned frame picked by the replacer, already removed
+  // from the page table. If the picked frame is dirty, it is pinned and
+  // returned through [out_dirty] instead (and nullptr is returned), to be
+  // written back by the caller without buffer_mutex and released with
+  // UnpinWriteback. Returns nullptr if all frames are pinned. Caller must
+  // hold buffer_mutex.
+  Page *GetVictimFrame(SizeClass *sc, Page **out_dirty);
+
+  // One attempt of EvictPage; [pinned] is set if it failed because someone
+  // else holds the page
+  bool TryEvictPage(PageId page_id, bool *pinned);
+
+  // Pin [page_id] if it is in the buffer pool, even if still being read;
+  // returns nullptr otherwise
+  Page *PinIfBuffered(PageId page_id);
+
+  // Wait for the read into a pinned frame to finish. Returns false (and
+  // drops the pin) if the read failed.
+  bool WaitForIo(Page *page);
+
+  // Publish the result of reading a page into a frame reserved by PinPage;
+  // on failure the frame is freed once all waiting pinners are gone
+  void FinishLoad(Page *page, bool success);
+
+  // Write back a pinned page and mark it clean. Caller must hold io_latch
+  // (shared) or buffer_mutex.
+  bool FlushFrame(BaseFile *file, Page *page);
+
+  // Reserve frames for pages [first, first + count) and queue their reads;
+  // with [trigger], the first reserved frame becomes a read-ahead trigger.
+  // Returns the number of reads issued. Caller must hold buffer_mutex and
+  // io_latch.
+  uint32_t PrefetchLocked(BaseFile *file, PageId first, uint32_t count, bool trigger);
+
+  // Prefetch the read-ahead window following [pid] if due; [miss] tells
+  // whether [pid] missed or hit a read-ahead trigger page. Caller must
+  // hold buffer_mutex and io_latch.
+  void ReadAheadLocked(BaseFile *file, PageId pid, bool miss);
+
+  // Completion of a prefetch read
+  static void PrefetchDone(IoRequest *req);
+
+  // Wait until all queued prefetches are done; returns false right away if
+  // there are none
+  bool DrainPrefetches();
+
+  // Pin a frame to write it back; caller must hold the latch of the page's
+  // partition
+  void PinForWriteback(Page *page);
+
+  // Drop a pin taken by PinForWriteback (or by GetVictimFrame on a dirty
+  // victim)
+  void UnpinWriteback(Page *page);
+
+  // Number of write-back pins dropped so far
+  uint64_t GetWritebackReleases();
+
+  // Wait until a write-back pin is dropped after GetWritebackReleases
+  // returned [releases]; returns false right away if none was held or
+  // dropped since
+  bool WaitForWriteback(uint64_t releases);
+
+  // Page cleaner thread body
+  void CleanerLoop();
+
+  // Write back up to [max_pages] dirty unpinned pages; returns the number of
+  // pages written
+  uint32_t CleanBatch(uint32_t max_pages);
+
 };
 }  // namespace yase
@@ -0,0 +1,237 @@
+/*
+ * YASE: Yet Another Storage Engine
+ *
+ * CMPT 454 Database Systems II, Spring 2025
+ *
+ * Copyright (C) School of Computing Science, Simon Fraser University
+ *
+ * Not for distribution without prior approval.
+ */
+#include <unistd.h>
+
+#include "catalog.h"
+
+namespace yase {
+
+Catalog::Catalog(std::string name, bool open_existing)
+  : file(name, false, PAGE_SIZE, open_existing) {
+  BufferManager::Get()->RegisterFile(&file);
+}
+
+Catalog::~Catalog() {
+  // Close the tables first; their files and the catalog are written back
+  // when unregistered from the buffer pool
+  tables.clear();
+  BufferManager *bm = BufferManager::Get();
+  if (bm) {
+    bm->UnregisterFile(&file);
+  }
+}
+
+Catalog::Entry *Catalog::FindEntry(const std::string &name, Page **out_page) {
+  BufferManager *bm = BufferManager::Get();
+  uint32_t entries_per_page = PAGE_SIZE / sizeof(Entry);
+  for (uint32_t i = 0; i < file.GetPageCount(); ++i) {
+    Page *p = bm->PinPage(PageId(file.GetId(), i));
+    if (!p) {
+      return nullptr;
+    }
+    p->Lock();
+    CatalogPage *cp = (CatalogPage *)p->page_data;
+    for (uint32_t j = 0; j < entries_per_page; ++j) {
+      Entry *entry = &cp->entries[j];
+      bool match = name.empty() ? entry->kind == Entry::Free
+                                : entry->kind != Entry::Free &&
+                                  strncmp(entry->name, name.c_str(), sizeof(entry->name)) == 0;
+      if (match) {
+        *out_page = p;
+        return entry;
+      }
+    }
+    p->Unlock();
+    bm->UnpinPage(p);
+  }
+  if (!name.empty()) {
+    return nullptr;
+  }
+
+  // All entries are taken; new pages come zeroed, i.e., with free entries
+  PageId pid = file.CreatePage();
+  Page *p = bm->PinPage(pid);
+  if (!p) {
+    return nullptr;
+  }
+  p->Lock();
+  *out_page = p;
+  return &((CatalogPage *)p->page_data)->entries[0];
+}
+
+void Catalog::ReleaseEntry(Page *page, bool dirty) {
+  if (dirty) {
+    page->SetDirty(true);
+  }
+  page->Unlock();
+  BufferManager::Get()->UnpinPage(page);
+}
+
+Table *Catalog::CreateTable(std::string name, uint32_t record_size, bool direct_io,
+                            uint32_t page_size) {
+  if (name.empty() || name.size() > kMaxNameLength) {
+    return nullptr;
+  }
+
+  std::lock_guard<std::mutex> lock(latch);
+  Page *p = nullptr;
+  if (FindEntry(name, &p)) {
+    ReleaseEntry(p, false);
+    return nullptr;
+  }
+
+  // Make sure there is a free entry before creating the table's files; with
+  // latch held, it stays free until the table is recorded
+  Entry *entry = FindEntry("", &p);
+  if (!entry) {
+    return nullptr;
+  }
+  ReleaseEntry(p, false);
+
+  Table *table = new Table(name, record_size, direct_io, page_size);
+  entry = FindEntry("", &p);
+  if (!entry) {
+    // Don't leave the files of an unrecorded table behind
+    delete table;
+    unlink(name.c_str());
+    unlink((name + ".dir").c_str());
+    return nullptr;
+  }
+  memset(entry, 0, sizeof(Entry));
+  strncpy(entry->name, name.c_str(), kMaxNameLength);
+  entry->kind = Entry::TableKind;
+  entry->flags = direct_io ? Entry::kDirectIo : 0;
+  entry->page_size = page_size;
+  entry->record_size = record_size;
+  entry->root_page = Entry::kInvalidRoot;
+  ReleaseEntry(p, true);
+
+  tables[name].reset(table);
+  return table;
+}
+
+Table *Catalog::GetTable(std::string name) {
+  std::lock_guard<std::mutex> lock(latch);
+  return GetTableLocked(name);
+}
+
+Table *Catalog::GetTableLocked(const std::string &name) {
+  auto it = tables.find(name);
+  if (it != tables.end()) {
+    return it->second.get();
+  }
+
+  Page *p = nullptr;
+  Entry *entry = FindEntry(name, &p);
+  if (!entry) {
+    return nullptr;
+  }
+  if (entry->kind != Entry::TableKind) {
+    ReleaseEntry(p, false);
+    return nullptr;
+  }
+  uint32_t record_size = entry->record_size;
+  uint32_t page_size = entry->page_size;
+  bool direct_io = entry->flags & Entry::kDirectIo;
+  ReleaseEntry(p, false);
+
+  Table *table = new Table(name, record_size, direct_io, page_size, true);
+  tables[name].reset(table);
+  return table;
+}
+
+bool Catalog::CreateIndex(std::string name, std::string table, uint32_t key_size,
+                          uint32_t payload_size) {
+  if (name.empty() || name.size() > kMaxNameLength ||
+      table.size() > Entry::kMaxTableNameLength) {
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(latch);
+  Page *p = nullptr;
+  Entry *entry = FindEntry(name, &p);
+  if (entry) {
+    ReleaseEntry(p, false);
+    return false;
+  }
+  entry = FindEntry(table, &p);
+  if (!entry) {
+    return false;
+  }
+  bool is_table = entry->kind == Entry::TableKind;
+  ReleaseEntry(p, false);
+  if (!is_table) {
+    return false;
+  }
+
+  entry = FindEntry("", &p);
+  if (!entry) {
+    return false;
+  }
+  memset(entry, 0, sizeof(Entry));
+  strncpy(entry->name, name.c_str(), kMaxNameLength);
+  strncpy(entry->table, table.c_str(), Entry::kMaxTableNameLength);
+  entry->kind = Entry::IndexKind;
+  entry->key_size = key_size;
+  entry->payload_size = payload_size;
+  entry->root_page = Entry::kInvalidRoot;
+  ReleaseEntry(p, true);
+  return true;
+}
+
+bool Catalog::SetIndexRoot(std::string name, RID root) {
+  std::lock_guard<std::mutex> lock(latch);
+  Page *p = nullptr;
+  Entry *entry = FindEntry(name, &p);
+  if (!entry) {
+    return false;
+  }
+  if (entry->kind != Entry::IndexKind) {
+    ReleaseEntry(p, false);
+    return false;
+  }
+
+  // File IDs change from run to run; the table name identifies the file
+  entry->root_page = root.IsValid() ? root.GetPageNum() : Entry::kInvalidRoot;
+  entry->root_slot = root.IsValid() ? root.GetSlotId() : 0;
+  ReleaseEntry(p, true);
+  return true;
+}
+
+bool Catalog::GetIndex(std::string name, IndexInfo *out_info) {
+  std::lock_guard<std::mutex> lock(latch);
+  Page *p = nullptr;
+  Entry *entry = FindEntry(name, &p);
+  if (!entry) {
+    return false;
+  }
+  if (entry->kind != Entry::IndexKind) {
+    ReleaseEntry(p, false);
+    return false;
+  }
+  out_info->table = entry->table;
+  out_info->key_size = entry->key_size;
+  out_info->payload_size = entry->payload_size;
+  uint32_t root_page = entry->root_page;
+  uint16_t root_slot = entry->root_slot;
+  ReleaseEntry(p, false);
+
+  out_info->root = RID();
+  if (root_page != Entry::kInvalidRoot) {
+    Table *table = GetTableLocked(out_info->table);
+    if (!table) {
+      return false;
+    }
+    out_info->root = RID(PageId(table->GetFileId(), root_page), root_slot);
+  }
+  return true;
+}
+
+}  // namespace yase
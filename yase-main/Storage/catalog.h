@@ -0,0 +1,139 @@
+/*
+ * YASE: Yet Another Storage Engine
+ *
+ * CMPT 454 Database Systems II, Spring 2025
+ *
+ * Copyright (C) School of Computing Science, Simon Fraser University
+ *
+ * Not for distribution without prior approval.
+ */
+#pragma once
+
+#include <map>
+#include <memory>
+#include <mutex>
+
+#include "../yase_internal.h"
+#include "basefile.h"
+#include "buffer_manager.h"
+#include "table.h"
+
+namespace yase {
+
+// Persistent catalog of the tables and indexes of a database, kept in its own
+// file and accessed through the buffer pool. Tables are opened lazily: the
+// first GetTable of a table reads its entry and opens its files; tables that
+// are never used are never opened.
+struct Catalog {
+  // Longest table or index name (the entry keeps a terminating zero)
+  static constexpr uint32_t kMaxNameLength = 55;
+
+  // Catalog entry of a table or an index
+  struct Entry {
+    enum Kind : uint8_t {
+      Free = 0,
+      TableKind = 1,
+      IndexKind = 2,
+    };
+
+    // Name of the table or index; a table's files are named [name] and
+    // "[name].dir"
+    char name[kMaxNameLength + 1];
+
+    // For indexes: name of the table that holds the index nodes
+    static constexpr uint32_t kMaxTableNameLength = 47;
+    char table[kMaxTableNameLength + 1];
+
+    Kind kind;
+
+    // Table flags
+    static constexpr uint8_t kDirectIo = 1;
+    uint8_t flags;
+
+    // For indexes: slot of the root (head) node
+    uint16_t root_slot;
+
+    // For tables: data page size and record size
+    uint32_t page_size;
+    uint32_t record_size;
+
+    // For indexes: key and payload size
+    uint32_t key_size;
+    uint32_t payload_size;
+
+    // For indexes: page number of the root (head) node; kInvalidRoot if unset
+    static constexpr uint32_t kInvalidRoot = ~uint32_t{0};
+    uint32_t root_page;
+  };
+  static_assert(sizeof(Entry) == 128, "Unexpected catalog entry size");
+
+  // Catalog page: an array of entries; new pages read as zeros, i.e., free
+  // entries
+  struct CatalogPage {
+    Entry entries[PAGE_SIZE / sizeof(Entry)];
+  };
+  static_assert(sizeof(CatalogPage) == PAGE_SIZE, "Wrong catalog page size");
+
+  // Index metadata returned by GetIndex
+  struct IndexInfo {
+    std::string table;
+    uint32_t key_size;
+    uint32_t payload_size;
+
+    // Root (head) node; invalid if not set yet. The file ID is that of the
+    // table as opened in this process.
+    RID root;
+  };
+
+  // @name: catalog file name
+  // @open_existing: open the catalog (and its tables) left by an earlier run
+  Catalog(std::string name, bool open_existing = false);
+  ~Catalog();
+
+  // Create a new table and add it to the catalog; returns nullptr if the
+  // name is too long or already used
+  // @name: table name
+  // @record_size: size of the table's records
+  // @direct_io: access the table's files with direct I/O
+  // @page_size: size of the table's data pages
+  Table *CreateTable(std::string name, uint32_t record_size, bool direct_io = false,
+                     uint32_t page_size = PAGE_SIZE);
+
+  // Return the table named [name], opening it on first access; returns
+  // nullptr if there is no such table
+  Table *GetTable(std::string name);
+
+  // Add an index whose nodes are stored in [table]; returns false if a name
+  // is too long, [name] is already used, or the table doesn't exist
+  bool CreateIndex(std::string name, std::string table, uint32_t key_size,
+                   uint32_t payload_size);
+
+  // Record the root (head) node of index [name]; returns false if there is
+  // no such index
+  bool SetIndexRoot(std::string name, RID root);
+
+  // Look up index [name]; returns false if there is no such index
+  bool GetIndex(std::string name, IndexInfo *out_info);
+
+  // Find the entry of [name] and return it with its catalog page pinned and
+  // latched; with [name] empty, a free entry is found (or made). Returns
+  // nullptr if there is none. Caller must hold latch.
+  Entry *FindEntry(const std::string &name, Page **out_page);
+
+  // Unlatch and unpin a page returned by FindEntry
+  void ReleaseEntry(Page *page, bool dirty);
+
+  // GetTable without taking latch. Caller must hold latch.
+  Table *GetTableLocked(const std::string &name);
+
+  // Catalog file
+  BaseFile file;
+
+  // Protects the catalog and the open tables
+  std::mutex latch;
+
+  // Tables opened so far
+  std::map<std::string, std::unique_ptr<Table>> tables;
+};
+
+}  // namespace yase
@@ -7,13 +7,15 @@
  *
  * Not for distribution without prior approval.
  */
+#include <cstdio>
 #include "basefile.h"
 #include "buffer_manager.h"
 #include "page.h"
 
 namespace yase {
 
-File::File(std::string name, uint16_t record_size) {
+File::File(std::string name, uint16_t record_size, bool direct_io, uint32_t page_size,
+           bool open_existing, const Schema &schema) {
   // 1. Initialize the structure as needed; in particular the directory BaseFile should be named as
   //    "name.dir".
   // 2. The file's both BaseFiles should be registered using BufferManager::RegisterFile.
@@ -21,26 +23,44 @@ File::File(std::string name, uint16_t record_size) {
   // TODO: Your implementation
   this->record_size = record_size;
   BufferManager *bm = BufferManager::Get();
-  new (this) BaseFile(name);
-  new (&dir) BaseFile(name + ".dir");
+  new (this) BaseFile(name, direct_io, page_size, open_existing);
+  this->schema = schema;
+  page_capacity = GetDataPageCapacity(page_size, record_size, schema);
+  uint32_t schema_size = 0;
+  for (uint16_t width : schema) {
+    schema_size += width;
+  }
+  LOG_IF(FATAL, !schema.empty() && (page_capacity == 0 || schema_size != record_size))
+      << "Unsupported PAX schema";
+  new (&dir) BaseFile(name + ".dir", direct_io, PAGE_SIZE, open_existing);
   bm->RegisterFile(this);
   bm->RegisterFile(&dir);
+  free_page_count = 0;
+  free_page_hint = 0;
+
+  // An existing directory is used as is; directory pages missing for data
+  // pages created last are added by AllocatePage. Its free pages and free
+  // space are summarized when first needed.
+  free_pages_loaded = dir.GetPageCount() == 0;
+  free_space_loaded = free_pages_loaded;
+  if (!free_pages_loaded) {
+    return;
+  }
 
   PageId dir_page_id = dir.CreatePage();
   Page *pinned_page = bm->PinPage(dir_page_id);
-  DirectoryPage *dir_page = pinned_page->GetDirPage();
-  uint32_t entries_per_dir_page = PAGE_SIZE / sizeof(DirectoryPage::Entry);
-  for (size_t i = 0; i < entries_per_dir_page; i++) {
-    dir_page->entries[i].free_slots = DataPage::GetCapacity(record_size);
-    dir_page->entries[i].allocated = false;
-    dir_page->entries[i].created = false;
-  }
+  memset(pinned_page->page_data, 0, PAGE_SIZE);
   pinned_page->SetDirty(true);
   bm->UnpinPage(pinned_page);
 }
 
 File::~File() {
-  // Nothing needed here
+  // Drop the buffered pages of both BaseFiles before they get closed
+  BufferManager *bm = BufferManager::Get();
+  if (bm) {
+    bm->UnregisterFile(this);
+    bm->UnregisterFile(&dir);
+  }
 }
 
 PageId File::AllocatePage() {
@@ -78,63 +98,33 @@ PageId File::AllocatePage() {
 
   PageId scavengedPage = ScavengePage();
   if(scavengedPage.IsValid()){
+    // Empty, but zeros if its space was reclaimed
     Page *data_page = bm->PinPage(scavengedPage);
-    data_page->SetDirty(true);
-    bm->UnpinPage(data_page);
+    if (data_page) {
+      data_page->Lock();
+      InitDataPage(GetPageSize(), data_page->page_data, record_size, schema);
+      data_page->free_slot_hint = 0;
+      data_page->SetDirty(true);
+      data_page->Unlock();
+      bm->UnpinPage(data_page);
+    }
     return scavengedPage;
   }
   
   // Case 2
-  static uint32_t entries_per_dir_page = PAGE_SIZE / sizeof(DirectoryPage::Entry);
-  uint32_t dir_page_num = (dir.GetPageCount() / entries_per_dir_page);
-  
-  Page *pinned_page;
-  PageId dir_page_pid = PageId(dir.GetId(), dir_page_num);
-  PageId data_pid = this->CreatePage();
-
-{
-  std::lock_guard<std::mutex> lock(file_latch);
-  //  Create new Dir page if not enough
-  if(data_pid.GetPageNum() >= (entries_per_dir_page * dir.GetPageCount())){
-    PageId new_dir_page_id = dir.CreatePage();
-    pinned_page = bm->PinPage(new_dir_page_id);
-    if(!pinned_page){
-      return PageId();
-    }
-    pinned_page->Lock();
-    DirectoryPage *new_dir_page = pinned_page->GetDirPage();
-    for (size_t i = 0; i < entries_per_dir_page; i++) {
-      new_dir_page->entries[i].free_slots = DataPage::GetCapacity(record_size);
-      new_dir_page->entries[i].allocated = false;
-      new_dir_page->entries[i].created = false;
-    }
+  PageId data_pid = AllocatePages(1);
+  if (!data_pid.IsValid()) {
+    return PageId();
   }
-  else{
-    pinned_page = bm->PinPage(dir_page_pid);
-    if (!pinned_page) {
-      return PageId();
-    }
-    pinned_page->Lock();
-  }
-}
-
-  DirectoryPage *dir_page = pinned_page->GetDirPage();
-  uint32_t index = (data_pid.GetPageNum() % entries_per_dir_page);
-  dir_page->entries[index].created = true;
-  dir_page->entries[index].allocated = true;
-  dir_page->entries[index].free_slots = DataPage::GetCapacity(record_size);
-  pinned_page->SetDirty(true);
-  pinned_page->Unlock();
-  bm->UnpinPage(pinned_page);
 
   // handle data page
   Page *data_page = bm->PinPage(data_pid);
   if(!data_page){
-    bm->UnpinPage(pinned_page);
     return data_pid;
   }
   data_page->Lock();
-  new (data_page->GetDataPage()) DataPage(record_size);
+  InitDataPage(GetPageSize(), data_page->page_data, record_size, schema);
+  data_page->free_slot_hint = 0;
   data_page->Unlock();
   data_page->SetDirty(true);
   bm->UnpinPage(data_page);
@@ -142,14 +132,77 @@ PageId File::AllocatePage() {
   return data_pid;
 }
 
+PageId File::AllocatePages(uint32_t count, bool full) {
+  BufferManager *bm = BufferManager::Get();
+  uint32_t entries_per_dir_page = DirectoryPage::kEntries;
+  PageId first_pid;
+  uint32_t first;
+  uint32_t end;
+  {
+    // Pages are created under file_latch, so ReclaimSpace can truncate
+    std::lock_guard<std::mutex> lock(file_latch);
+    first_pid = CreatePages(count);
+    if (!first_pid.IsValid()) {
+      // The file reached the maximum number of pages
+      return PageId();
+    }
+    first = first_pid.GetPageNum();
+    end = first + count;
+
+    // Create new Dir pages if not enough; concurrent allocations may need
+    // more than one
+    while (dir.GetPageCount() <= (end - 1) / entries_per_dir_page) {
+      PageId new_dir_page_id = dir.CreatePage();
+      Page *pinned_page = bm->PinPage(new_dir_page_id);
+      if (!pinned_page) {
+        return PageId();
+      }
+      pinned_page->Lock();
+      memset(pinned_page->page_data, 0, PAGE_SIZE);
+      pinned_page->SetDirty(true);
+      pinned_page->Unlock();
+      bm->UnpinPage(pinned_page);
+    }
+  }
+
+  // Mark the run allocated, one directory page at a time
+  for (uint32_t page_num = first; page_num < end;) {
+    uint32_t dir_page_num = page_num / entries_per_dir_page;
+    uint32_t dir_end = std::min(end, (dir_page_num + 1) * entries_per_dir_page);
+    Page *pinned_page = bm->PinPage(PageId(dir.GetId(), dir_page_num));
+    if (!pinned_page) {
+      return PageId();
+    }
+    pinned_page->Lock();
+    DirectoryPage *dir_page = pinned_page->GetDirPage();
+    for (; page_num < dir_end; ++page_num) {
+      dir_page->SetEntry(page_num % entries_per_dir_page,
+                         DirectoryPage::kCreated | DirectoryPage::kAllocated |
+                         (full ? DirectoryPage::kFull : DirectoryPage::kEmpty) << 2);
+    }
+    pinned_page->SetDirty(true);
+    pinned_page->Unlock();
+    bm->UnpinPage(pinned_page);
+  }
+
+  // Full pages never enter the free-space map
+  std::lock_guard<std::mutex> lock(free_space_latch);
+  if (free_space_loaded && !full) {
+    for (uint32_t page_num = first; page_num < end; ++page_num) {
+      free_space.Set(page_num, page_capacity);
+    }
+  }
+  return first_pid;
+}
+
 bool File::DeallocatePage(PageId data_pid) {
   // Mark the data page as deallocated in its corresponding directory page entry 
   //
   // TODO: Your implementation
-  static uint32_t entries_per_dir_page = PAGE_SIZE / sizeof(DirectoryPage::Entry);
-  uint32_t dir_limit = entries_per_dir_page * dir.GetPageCount();
+  static uint32_t entries_per_dir_page = DirectoryPage::kEntries;
+  uint64_t dir_limit = (uint64_t)entries_per_dir_page * dir.GetPageCount();
 
-  if(data_pid.GetPageNum() > dir_limit){
+  if(data_pid.GetPageNum() >= dir_limit || data_pid.GetPageNum() >= GetPageCount()){
     return false;
   }
   
@@ -165,28 +218,33 @@ bool File::DeallocatePage(PageId data_pid) {
   pinned_page->Lock();
   DirectoryPage *dir_page = pinned_page->GetDirPage();
 
-  if (!dir_page->entries[index].created) {
-    pinned_page->Unlock();
-    bm->UnpinPage(pinned_page);
+  bool allocated = dir_page->IsCreated(index) && dir_page->IsAllocated(index);
+  if(allocated){
+    dir_page->SetAllocated(index, false);
+    dir_page->SetFreeClass(index, DirectoryPage::kEmpty);
+    pinned_page->SetDirty(true);
+  }
+  pinned_page->Unlock();
+  bm->UnpinPage(pinned_page);
+  if (!allocated) {
     return false;
   }
 
-  bool allocated = dir_page->entries[index].allocated;
-  if(allocated){
-    dir_page->entries[index].allocated = false;
-
-    Page *data_page = bm->PinPage(data_pid);
+  // Empty the page before it can be scavenged; the two pages are never
+  // pinned together, so concurrent deallocations need few frames.
+  // AllocatePage formats scavenged pages anyway.
+  Page *data_page = bm->PinPage(data_pid);
+  if (data_page) {
     data_page->Lock();
-    DataPage *dp = data_page->GetDataPage();
-    dp->record_count = 0;
+    InitDataPage(GetPageSize(), data_page->page_data, record_size, schema);
+    data_page->free_slot_hint = 0;
     data_page->SetDirty(true);
     data_page->Unlock();
     bm->UnpinPage(data_page);
   }
-  pinned_page->SetDirty(true);
-  pinned_page->Unlock();
-  bm->UnpinPage(pinned_page);
-  return allocated;
+  UpdateFreeSpace(data_pid.GetPageNum(), 0);
+  AddFreePage(data_pid.GetPageNum());
+  return true;
 }
 
 bool File::PageExists(PageId pid) {
@@ -195,7 +253,7 @@ bool File::PageExists(PageId pid) {
 
   BufferManager *bm = BufferManager::Get();
 
-  static uint32_t entries_per_dir_page = PAGE_SIZE / sizeof(DirectoryPage::Entry);
+  static uint32_t entries_per_dir_page = DirectoryPage::kEntries;
   uint32_t dir_page_num = (pid.GetPageNum() / entries_per_dir_page);
   uint32_t index = (pid.GetPageNum() % entries_per_dir_page);
   PageId dir_pid(dir.GetId(), dir_page_num);
@@ -207,49 +265,369 @@ bool File::PageExists(PageId pid) {
   pinned_page->Lock();
   DirectoryPage *dir_page = pinned_page->GetDirPage();
 
-  bool exists = dir_page->entries[index].allocated;
+  bool exists = dir_page->IsAllocated(index);
   pinned_page->Unlock();
   bm->UnpinPage(pinned_page);
   return exists;
 }
 
-PageId File::ScavengePage() {
-  // Loop over all directory pages, and for each page, check if any entry represents a "created" but
-  // not "allocatd" page. If so, allocate and initialize it. 
-  //
-  // Return the page ID of the allocated data page; an invalid page ID should be returned if no page
-  // is scavenged.
-  //
-  // TODO: Your implementation
+bool File::GetAllocated(uint32_t dir_page_num, std::vector<bool> *out_allocated) {
+  BufferManager *bm = BufferManager::Get();
+  Page *pinned_page = bm->PinPage(PageId(dir.GetId(), dir_page_num));
+  if (!pinned_page) {
+    return false;
+  }
+  pinned_page->Lock();
+  DirectoryPage *dir_page = pinned_page->GetDirPage();
+  out_allocated->resize(DirectoryPage::kEntries);
+  for (uint32_t i = 0; i < DirectoryPage::kEntries; ++i) {
+    (*out_allocated)[i] = dir_page->IsAllocated(i);
+  }
+  pinned_page->Unlock();
+  bm->UnpinPage(pinned_page);
+  return true;
+}
+
+bool File::LoadFreePages() {
+  if (free_pages_loaded) {
+    return true;
+  }
+
+  // One pass over the directory; deallocations that happen meanwhile wait
+  // for free_page_latch and are added afterwards
+  BufferManager *bm = BufferManager::Get();
+  uint32_t entries_per_dir_page = DirectoryPage::kEntries;
+  for (uint32_t i = 0; i < dir.GetPageCount(); i++) {
+    Page *pinned_page = bm->PinPage(PageId(dir.GetId(), i));
+    if (!pinned_page) {
+      free_pages.clear();
+      free_page_count = 0;
+      return false;
+    }
+    pinned_page->Lock();
+    DirectoryPage *dir_page = pinned_page->GetDirPage();
+    for (uint32_t j = 0; j < entries_per_dir_page; j++) {
+      uint32_t page_num = i * entries_per_dir_page + j;
+      // Pages past the end were truncated by ReclaimSpace before a crash
+      if (dir_page->IsCreated(j) && !dir_page->IsAllocated(j) && page_num < GetPageCount()) {
+        if (free_pages.size() <= page_num / 64) {
+          free_pages.resize(page_num / 64 + 1, 0);
+        }
+        free_pages[page_num / 64] |= uint64_t{1} << (page_num % 64);
+        ++free_page_count;
+      }
+    }
+    pinned_page->Unlock();
+    bm->UnpinPage(pinned_page);
+  }
+  free_page_hint = 0;
+  free_pages_loaded = true;
+  return true;
+}
 
+void File::AddFreePage(uint32_t page_num) {
+  std::lock_guard<std::mutex> lock(free_page_latch);
+  if (!free_pages_loaded) {
+    // Loading will find it in the directory
+    return;
+  }
+  uint32_t word = page_num / 64;
+  if (free_pages.size() <= word) {
+    free_pages.resize(word + 1, 0);
+  }
+  free_pages[word] |= uint64_t{1} << (page_num % 64);
+  ++free_page_count;
+  free_page_hint = std::min(free_page_hint, word);
+}
+
+PageId File::ScavengePage(bool full) {
+  // Take the lowest deallocated page out of the bitmap, then mark it
+  // allocated in its directory entry. The directory page is latched without
+  // free_page_latch, which DeallocatePage takes after releasing it.
   BufferManager *bm = BufferManager::Get();
-  uint32_t entries_per_dir_page = PAGE_SIZE / sizeof(DirectoryPage::Entry);
-  PageId current_dir_pid = PageId(dir.GetId(), 0);
+  uint32_t entries_per_dir_page = DirectoryPage::kEntries;
+  while (true) {
+    uint32_t page_num;
+    {
+      std::lock_guard<std::mutex> lock(free_page_latch);
+      if (!LoadFreePages() || free_page_count == 0) {
+        return PageId();
+      }
+      while (free_pages[free_page_hint] == 0) {
+        ++free_page_hint;
+      }
+      uint64_t &bits = free_pages[free_page_hint];
+      page_num = free_page_hint * 64 + __builtin_ctzll(bits);
+      bits &= bits - 1;
+      --free_page_count;
+    }
 
-  for(uint32_t i=0; i < dir.GetPageCount(); i++){
-    Page *pinned_page = bm->PinPage(current_dir_pid);
-    if(!pinned_page){
+    Page *pinned_page = bm->PinPage(PageId(dir.GetId(), page_num / entries_per_dir_page));
+    if (!pinned_page) {
+      AddFreePage(page_num);
       return PageId();
     }
     pinned_page->Lock();
     DirectoryPage *dir_page = pinned_page->GetDirPage();
-    for (size_t j=0; j < entries_per_dir_page; j++) {
-      if (dir_page->entries[j].created && !dir_page->entries[j].allocated) {
-        dir_page->entries[j].allocated = true;
-        dir_page->entries[j].free_slots = DataPage::GetCapacity(record_size);
-        PageId allocated_pid = PageId(this->GetId(), i * entries_per_dir_page + j);
-        pinned_page->SetDirty(true);
-        pinned_page->Unlock();
-        bm->UnpinPage(pinned_page);
-        return allocated_pid;
+    uint32_t index = page_num % entries_per_dir_page;
+    bool scavenged = dir_page->IsCreated(index) && !dir_page->IsAllocated(index);
+    bool punched = scavenged && dir_page->GetFreeClass(index) == DirectoryPage::kHole;
+    if (scavenged) {
+      // Deallocation emptied the page
+      dir_page->SetEntry(index, DirectoryPage::kCreated | DirectoryPage::kAllocated |
+                                (full ? DirectoryPage::kFull : DirectoryPage::kEmpty) << 2);
+      pinned_page->SetDirty(true);
+    }
+    pinned_page->Unlock();
+    bm->UnpinPage(pinned_page);
+    if (scavenged) {
+      if (punched) {
+        // Get space back in one go rather than block by block as it's
+        // written; it's only a hint, so failure doesn't matter
+        FillPages(page_num, 1);
+      }
+      UpdateFreeSpace(page_num, full ? 0 : page_capacity);
+      return PageId(this->GetId(), page_num);
+    }
+  }
+}
+
+bool File::TakeFreePage(uint32_t page_num) {
+  std::lock_guard<std::mutex> lock(free_page_latch);
+  uint32_t word = page_num / 64;
+  uint64_t bit = uint64_t{1} << (page_num % 64);
+  if (!LoadFreePages() || free_pages.size() <= word || !(free_pages[word] & bit)) {
+    return false;
+  }
+  free_pages[word] &= ~bit;
+  --free_page_count;
+  return true;
+}
+
+uint32_t File::ReclaimSpace(uint32_t *skipped) {
+  BufferManager *bm = BufferManager::Get();
+  uint32_t entries_per_dir_page = DirectoryPage::kEntries;
+
+  // No pages are created meanwhile, so the end of the file stays put
+  std::lock_guard<std::mutex> lock(file_latch);
+  uint32_t not_reclaimed = 0;
+  if (skipped) {
+    *skipped = 0;
+  }
+  std::vector<uint32_t> pages;
+  {
+    std::lock_guard<std::mutex> free_lock(free_page_latch);
+    if (!LoadFreePages()) {
+      return 0;
+    }
+    for (uint32_t word = 0; word < free_pages.size(); ++word) {
+      for (uint64_t bits = free_pages[word]; bits; bits &= bits - 1) {
+        pages.push_back(word * 64 + __builtin_ctzll(bits));
+      }
+    }
+  }
+
+  // Like ScavengePage, take each page out of free_pages while working on
+  // it, so it can't be allocated meanwhile. Buffered copies are written
+  // back before the space goes, so no later write-back fills it again.
+  uint32_t reclaimed = 0;
+  uint32_t end = GetPageCount();
+  uint32_t tail = end;
+  while (!pages.empty() && pages.back() == tail - 1) {
+    if (!TakeFreePage(tail - 1)) {
+      break;
+    }
+    if (!bm->EvictPage(PageId(GetId(), tail - 1))) {
+      AddFreePage(tail - 1);
+      break;
+    }
+    --tail;
+    pages.pop_back();
+  }
+
+  for (uint32_t page_num : pages) {
+    if (page_num >= tail || !TakeFreePage(page_num)) {
+      continue;
+    }
+    Page *pinned_page = bm->PinPage(PageId(dir.GetId(), page_num / entries_per_dir_page));
+    if (!pinned_page) {
+      AddFreePage(page_num);
+      ++not_reclaimed;
+      continue;
+    }
+    uint32_t index = page_num % entries_per_dir_page;
+    pinned_page->Lock();
+    bool punched = pinned_page->GetDirPage()->GetFreeClass(index) == DirectoryPage::kHole;
+    pinned_page->Unlock();
+    if (!punched && bm->EvictPage(PageId(GetId(), page_num)) && PunchPages(page_num, 1)) {
+      pinned_page->Lock();
+      pinned_page->GetDirPage()->SetFreeClass(index, DirectoryPage::kHole);
+      pinned_page->SetDirty(true);
+      pinned_page->Unlock();
+      ++reclaimed;
+    } else if (!punched) {
+      ++not_reclaimed;
+    }
+    bm->UnpinPage(pinned_page);
+    AddFreePage(page_num);
+  }
+
+  if (skipped) {
+    *skipped = not_reclaimed;
+  }
+  if (tail == end) {
+    return reclaimed;
+  }
+
+  if (!Truncate(tail)) {
+    for (uint32_t page_num = tail; page_num < end; ++page_num) {
+      AddFreePage(page_num);
+    }
+    if (skipped) {
+      *skipped += end - tail;
+    }
+    return reclaimed;
+  }
+
+  // Entries of pages past the end are ignored (see LoadFreePages), so a
+  // crash before the directory is written back does no harm
+  for (uint32_t page_num = tail; page_num < end;) {
+    uint32_t dir_page_num = page_num / entries_per_dir_page;
+    uint32_t dir_end = std::min(end, (dir_page_num + 1) * entries_per_dir_page);
+    Page *pinned_page = bm->PinPage(PageId(dir.GetId(), dir_page_num));
+    if (!pinned_page) {
+      break;
+    }
+    pinned_page->Lock();
+    for (; page_num < dir_end; ++page_num) {
+      pinned_page->GetDirPage()->SetEntry(page_num % entries_per_dir_page, 0);
+    }
+    pinned_page->SetDirty(true);
+    pinned_page->Unlock();
+    bm->UnpinPage(pinned_page);
+  }
+  return reclaimed + end - tail;
+}
+
+bool File::LoadFreeSpace() {
+  if (free_space_loaded) {
+    return true;
+  }
+
+  // Like LoadFreePages, updates made meanwhile wait for free_space_latch
+  BufferManager *bm = BufferManager::Get();
+  uint32_t entries_per_dir_page = DirectoryPage::kEntries;
+  for (uint32_t i = 0; i < dir.GetPageCount(); i++) {
+    Page *pinned_page = bm->PinPage(PageId(dir.GetId(), i));
+    if (!pinned_page) {
+      free_space.Clear();
+      return false;
+    }
+    pinned_page->Lock();
+    DirectoryPage *dir_page = pinned_page->GetDirPage();
+    for (uint32_t j = 0; j < entries_per_dir_page; j++) {
+      if (dir_page->IsAllocated(j) && dir_page->GetFreeClass(j) != DirectoryPage::kFull) {
+        free_space.Set(i * entries_per_dir_page + j,
+                       DirectoryPage::GetMinFreeSlots(dir_page->GetFreeClass(j), page_capacity));
       }
     }
-    //move to next page
-    current_dir_pid = PageId(current_dir_pid.GetFileId(), current_dir_pid.GetPageNum() + 1);
     pinned_page->Unlock();
     bm->UnpinPage(pinned_page);
   }
-  return PageId();
+  free_space_loaded = true;
+  return true;
+}
+
+void File::UpdateFreeSpace(uint32_t page_num, uint16_t free_slots) {
+  std::lock_guard<std::mutex> lock(free_space_latch);
+  if (free_space_loaded) {
+    free_space.Set(page_num, free_slots);
+  }
+}
+
+bool File::SetFreeSlots(uint32_t page_num, uint16_t free_slots) {
+  BufferManager *bm = BufferManager::Get();
+  uint32_t entries_per_dir_page = DirectoryPage::kEntries;
+  Page *pinned_page = bm->PinPage(PageId(dir.GetId(), page_num / entries_per_dir_page));
+  if (!pinned_page) {
+    return false;
+  }
+  pinned_page->Lock();
+  DirectoryPage *dir_page = pinned_page->GetDirPage();
+  uint32_t index = page_num % entries_per_dir_page;
+  uint8_t free_class = DirectoryPage::GetFreeClass(free_slots, page_capacity);
+  bool allocated = dir_page->IsAllocated(index);
+  bool changed = allocated && dir_page->GetFreeClass(index) != free_class;
+  if (changed) {
+    // Most inserts and deletes keep the class, and don't dirty the directory
+    dir_page->SetFreeClass(index, free_class);
+    pinned_page->SetDirty(true);
+  }
+  pinned_page->Unlock();
+  bm->UnpinPage(pinned_page);
+  // A record fits in any page that isn't full, so the map is updated when
+  // the class changes; variable-length records need the exact free space
+  if (changed || (allocated && record_size == kVariableRecordSize)) {
+    UpdateFreeSpace(page_num, free_slots);
+  }
+  return true;
+}
+
+PageId File::FindPageWithSpace(uint16_t min_free_slots) {
+  std::lock_guard<std::mutex> lock(free_space_latch);
+  if (!LoadFreeSpace()) {
+    return PageId();
+  }
+  uint32_t page_num = free_space.Find(min_free_slots);
+  if (page_num == FreeSpaceMap::kInvalidPage) {
+    return PageId();
+  }
+  return PageId(GetId(), page_num);
+}
+
+bool File::ConvertDirectory(std::string name, uint16_t record_size, uint32_t page_size) {
+  // Old and new directory pages are both PAGE_SIZE bytes; each new page
+  // covers the entries of several old ones
+  static const uint32_t kLegacyEntries = PAGE_SIZE / sizeof(LegacyDirectoryEntry);
+  static const uint32_t kOldPagesPerPage = DirectoryPage::kEntries / kLegacyEntries;
+  uint16_t capacity = GetDataPageCapacity(page_size, record_size);
+  std::string dir_name = name + ".dir";
+  std::string new_name = dir_name + ".new";
+  {
+    BaseFile old_dir(dir_name, false, PAGE_SIZE, true);
+    BaseFile new_dir(new_name);
+    std::vector<LegacyDirectoryEntry> old_entries(kLegacyEntries);
+    DirectoryPage new_page;
+    for (uint32_t i = 0; i < old_dir.GetPageCount(); i += kOldPagesPerPage) {
+      memset(&new_page, 0, sizeof(new_page));
+      for (uint32_t k = 0; k < kOldPagesPerPage && i + k < old_dir.GetPageCount(); ++k) {
+        if (!old_dir.LoadPage(PageId(old_dir.GetId(), i + k), old_entries.data())) {
+          return false;
+        }
+        for (uint32_t j = 0; j < kLegacyEntries; ++j) {
+          LegacyDirectoryEntry &entry = old_entries[j];
+          if (!entry.created) {
+            continue;
+          }
+          uint32_t index = k * kLegacyEntries + j;
+          new_page.SetEntry(index, DirectoryPage::kCreated |
+                                   (entry.allocated ? DirectoryPage::kAllocated : 0));
+          // Deallocated pages are scavenged as empty
+          new_page.SetFreeClass(index, entry.allocated
+                                       ? DirectoryPage::GetFreeClass(entry.free_slots, capacity)
+                                       : DirectoryPage::kEmpty);
+        }
+      }
+      PageId pid = new_dir.CreatePage();
+      if (!pid.IsValid() || !new_dir.FlushPage(pid, &new_page)) {
+        return false;
+      }
+    }
+    if (!new_dir.Sync()) {
+      return false;
+    }
+  }
+  return std::rename(new_name.c_str(), dir_name.c_str()) == 0;
 }
 
 }  // namespace yase
\ No newline at end of file
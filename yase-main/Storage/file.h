@@ -11,14 +11,26 @@
 
 #include "../yase_internal.h"
 #include "basefile.h"
+#include "free_space_map.h"
 #include "page.h"
 #include <mutex>
+#include <vector>
 
 namespace yase {
 
 // Underlying structure of Table to read/write data
 struct File : public BaseFile {
-  File(std::string name, uint16_t record_size);
+  // @name: file name; the directory is kept in "name.dir"
+  // @record_size: size of the records stored in the data pages
+  // @direct_io: access both files with direct I/O
+  // @page_size: size of the data pages; directory pages are PAGE_SIZE
+  // @open_existing: reopen the file and its directory as they were left
+  //                 (record and page size must be the same as before)
+  // @schema: field widths, adding up to [record_size], to store the records
+  //          in PAX pages (see PaxPageT); row pages if empty
+  File(std::string name, uint16_t record_size, bool direct_io = false,
+       uint32_t page_size = PAGE_SIZE, bool open_existing = false,
+       const Schema &schema = Schema());
   ~File();
 
   std::mutex file_mutex;
@@ -28,6 +40,15 @@ struct File : public BaseFile {
   // If no page is allocated, return an invalid PageId
   PageId AllocatePage();
 
+  // Allocate [count] new data pages with consecutive page numbers, e.g., for
+  // bulk loading. The pages are not formatted: they read as zeros, which
+  // users must treat as an empty data page (see Table::Insert).
+  // Returns the Page ID of the first page, or an invalid PageId if no page
+  // is allocated
+  // @full: record the pages as full, so inserts never pick them (e.g.,
+  //        overflow pages, see OverflowPageT)
+  PageId AllocatePages(uint32_t count, bool full = false);
+
   // Deallocate an existing page
   // @pid: ID of the page to be deallocated
   // Returns true/false if the page is deallocated/already deallocated
@@ -36,12 +57,67 @@ struct File : public BaseFile {
   // Return a pointer to the dir basefile object
   inline BaseFile *GetDir() { return &dir; }
 
+  // Rewrite the directory of file [name], which must not be open, from the
+  // original format (LegacyDirectoryEntry) to the current one
+  // @record_size, @page_size: as the file was created with
+  // Returns true/false if succeeded/failed
+  static bool ConvertDirectory(std::string name, uint16_t record_size,
+                               uint32_t page_size = PAGE_SIZE);
+
   // Return true if the specified page is allocated (i.e., "exists")
   bool PageExists(PageId pid);
 
+  // Read whether each data page of directory page [dir_page_num] is
+  // allocated into [out_allocated], indexed by page number modulo
+  // DirectoryPage::kEntries; cheaper than PageExists on each of them.
+  // Returns false if the directory page can't be read.
+  bool GetAllocated(uint32_t dir_page_num, std::vector<bool> *out_allocated);
+
   // Try to find a previously-deallocated page, and allocate it
   // Returns invalid PageId if no such page is found.
-  PageId ScavengePage();
+  // @full: as in AllocatePages
+  PageId ScavengePage(bool full = false);
+
+  // Fill free_pages from the directory, if not done yet. Caller must hold
+  // free_page_latch.
+  bool LoadFreePages();
+
+  // Record data page [page_num] as deallocated in free_pages
+  void AddFreePage(uint32_t page_num);
+
+  // Take data page [page_num] out of free_pages; returns false if it isn't
+  // there
+  bool TakeFreePage(uint32_t page_num);
+
+  // Return the space of deallocated data pages to the file system: a
+  // trailing run of them is truncated off the file, the others are punched
+  // out and marked as holes in the directory (scavenging one allocates its
+  // space again). Pages that are pinned are left alone.
+  // @skipped: if given, set to the number of deallocated pages whose space
+  // could not be returned (pinned pages or failed I/O)
+  // Returns the number of pages whose space was returned
+  uint32_t ReclaimSpace(uint32_t *skipped = nullptr);
+
+  // Record the free slots (free bytes for variable-length records) of
+  // allocated data page [page_num] in the free-space map; called after
+  // updating the page's directory entry
+  void UpdateFreeSpace(uint32_t page_num, uint16_t free_slots);
+
+  // Set the free-space class in the directory entry of data page
+  // [page_num], if allocated, from its [free_slots] (free bytes for
+  // variable-length records, see page_capacity), and update the
+  // free-space map. Caller must hold the data page's latch (data pages are
+  // latched before directory pages).
+  bool SetFreeSlots(uint32_t page_num, uint16_t free_slots);
+
+  // Return the lowest-numbered allocated page with at least [min_free_slots]
+  // free slots (bytes for variable-length records), according to the
+  // free-space map; invalid PageId if there is none
+  PageId FindPageWithSpace(uint16_t min_free_slots = 1);
+
+  // Fill free_space from the directory, if not done yet. Caller must hold
+  // free_space_latch.
+  bool LoadFreeSpace();
 
   // BaseFile for managing directory pages
   BaseFile dir;
@@ -49,7 +125,36 @@ struct File : public BaseFile {
   // Record size supported by data pages in this file
   uint16_t record_size;
 
+  // Fields of the records if data pages are PAX pages; empty otherwise
+  Schema schema;
+
+  // Number of records a data page in this file holds; for variable-length
+  // records (kVariableRecordSize), the longest record a page can take
+  uint16_t page_capacity;
+
   std::mutex file_latch;
+
+  // Deallocated (created but not allocated) data pages: bit n of the bitmap
+  // is set for page n. Built from the directory on first use, then kept up
+  // to date, so scavenging a page never walks the directory.
+  std::mutex free_page_latch;
+  bool free_pages_loaded;
+  std::vector<uint64_t> free_pages;
+
+  // Number of set bits in free_pages, and the first word that may have one
+  uint32_t free_page_count;
+  uint32_t free_page_hint;
+
+  // Free slots (bytes for variable-length records) of the allocated data
+  // pages. Only their free-space classes are persisted, in the directory
+  // entries; the map is built from the directory on first use, taking the
+  // fewest free slots of each class, and kept exact from then on for
+  // variable-length records, and up to class otherwise (see SetFreeSlots).
+  // It is a hint: updates are applied after the directory entry is, without
+  // its latch, so users must cope with a page being full.
+  std::mutex free_space_latch;
+  bool free_space_loaded;
+  FreeSpaceMap free_space;
 };
 
 }  // namespace yase
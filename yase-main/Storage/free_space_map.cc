@@ -0,0 +1,68 @@
+/*
+ * YASE: Yet Another Storage Engine
+ *
+ * CMPT 454 Database Systems II, Spring 2025
+ *
+ * Copyright (C) School of Computing Science, Simon Fraser University
+ *
+ * Not for distribution without prior approval.
+ */
+#include <algorithm>
+
+#include "free_space_map.h"
+
+namespace yase {
+
+void FreeSpaceMap::Set(uint32_t page_num, uint16_t free_space) {
+  if (page_num >= leaves) {
+    if (free_space == 0) {
+      return;
+    }
+    // Grow to the next power of two and rebuild the inner nodes; page
+    // numbers use all 32 bits, so the sizes need 64
+    uint64_t new_leaves = std::max<uint64_t>(leaves, kMinLeaves);
+    while (new_leaves <= page_num) {
+      new_leaves *= 2;
+    }
+    std::vector<uint16_t> new_tree(2 * new_leaves, 0);
+    std::copy(tree.begin() + leaves, tree.end(), new_tree.begin() + new_leaves);
+    for (uint64_t i = new_leaves - 1; i > 0; --i) {
+      new_tree[i] = std::max(new_tree[2 * i], new_tree[2 * i + 1]);
+    }
+    tree.swap(new_tree);
+    leaves = new_leaves;
+  }
+
+  uint64_t i = leaves + page_num;
+  tree[i] = free_space;
+  for (i /= 2; i > 0; i /= 2) {
+    uint16_t max = std::max(tree[2 * i], tree[2 * i + 1]);
+    if (tree[i] == max) {
+      break;
+    }
+    tree[i] = max;
+  }
+}
+
+uint16_t FreeSpaceMap::Get(uint32_t page_num) {
+  return page_num < leaves ? tree[leaves + page_num] : 0;
+}
+
+uint32_t FreeSpaceMap::Find(uint16_t min_space) {
+  if (leaves == 0 || tree[1] < min_space) {
+    return kInvalidPage;
+  }
+  // Descend to the leftmost leaf that has enough
+  uint64_t i = 1;
+  while (i < leaves) {
+    i = tree[2 * i] >= min_space ? 2 * i : 2 * i + 1;
+  }
+  return i - leaves;
+}
+
+void FreeSpaceMap::Clear() {
+  tree.clear();
+  leaves = 0;
+}
+
+}  // namespace yase
@@ -0,0 +1,49 @@
+/*
+ * YASE: Yet Another Storage Engine
+ *
+ * CMPT 454 Database Systems II, Spring 2025
+ *
+ * Copyright (C) School of Computing Science, Simon Fraser University
+ *
+ * Not for distribution without prior approval.
+ */
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace yase {
+
+// Free-space map of a file: the free space of each data page (any measure
+// where larger means more, e.g., free slots or a free-space class),
+// summarized in a tree of maxima (each node holds the largest value below
+// it), so the first page with enough free space is found in O(log n).
+// Not thread-safe; File serializes access.
+struct FreeSpaceMap {
+  static constexpr uint32_t kInvalidPage = ~uint32_t{0};
+  static constexpr uint32_t kMinLeaves = 64;
+
+  FreeSpaceMap() : leaves(0) {}
+
+  // Record that page [page_num] has [free_space]
+  void Set(uint32_t page_num, uint16_t free_space);
+
+  // Return the recorded free space of [page_num]
+  uint16_t Get(uint32_t page_num);
+
+  // Return the lowest-numbered page with at least [min_space]; kInvalidPage
+  // if there is none
+  uint32_t Find(uint16_t min_space);
+
+  // Forget all pages
+  void Clear();
+
+  // Number of leaves, a power of two (0 if empty)
+  uint64_t leaves;
+
+  // Implicit binary tree: tree[1] is the root, the children of node i are
+  // 2i and 2i + 1, and page n is leaf tree[leaves + n]
+  std::vector<uint16_t> tree;
+};
+
+}  // namespace yase
@@ -0,0 +1,366 @@
+/*
+ * YASE: Yet Another Storage Engine
+ *
+ * CMPT 454 Database Systems II, Spring 2025
+ *
+ * Copyright (C) School of Computing Science, Simon Fraser University
+ *
+ * Not for distribution without prior approval.
+ */
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <glog/logging.h>
+
+#ifdef YASE_HAVE_IO_URING
+#include <linux/io_uring.h>
+#endif
+
+#include "io_engine.h"
+
+namespace yase {
+
+IoEngine *IoEngine::Create(Backend backend, uint32_t queue_depth) {
+  if (backend != ThreadPool) {
+    IoEngine *engine = UringIoEngine::Create(queue_depth);
+    if (engine || backend == Uring) {
+      return engine;
+    }
+  }
+  return new ThreadPoolIoEngine(kDefaultThreads);
+}
+
+uint32_t IoEngine::SubmitAndWait(IoRequest **reqs, uint32_t count) {
+  struct Waiter {
+    std::mutex latch;
+    std::condition_variable cv;
+    uint32_t remaining;
+  } waiter;
+  waiter.remaining = count;
+
+  for (uint32_t i = 0; i < count; ++i) {
+    reqs[i]->arg = &waiter;
+    reqs[i]->callback = [](IoRequest *req) {
+      Waiter *w = (Waiter *)req->arg;
+      std::lock_guard<std::mutex> lock(w->latch);
+      if (--w->remaining == 0) {
+        w->cv.notify_one();
+      }
+    };
+  }
+  Submit(reqs, count);
+
+  std::unique_lock<std::mutex> lock(waiter.latch);
+  waiter.cv.wait(lock, [&waiter]() { return waiter.remaining == 0; });
+  uint32_t succeeded = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    if (reqs[i]->Succeeded()) {
+      ++succeeded;
+    }
+  }
+  return succeeded;
+}
+
+ThreadPoolIoEngine::ThreadPoolIoEngine(uint32_t thread_count)
+  : stop(false), head(nullptr), tail(nullptr) {
+  for (uint32_t i = 0; i < thread_count; ++i) {
+    workers.emplace_back(&ThreadPoolIoEngine::WorkerLoop, this);
+  }
+}
+
+ThreadPoolIoEngine::~ThreadPoolIoEngine() {
+  // Workers finish the queued requests before they exit
+  {
+    std::lock_guard<std::mutex> lock(latch);
+    stop = true;
+  }
+  cv.notify_all();
+  for (auto &t : workers) {
+    t.join();
+  }
+}
+
+void ThreadPoolIoEngine::Submit(IoRequest **reqs, uint32_t count) {
+  if (count == 0) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(latch);
+    for (uint32_t i = 0; i < count; ++i) {
+      reqs[i]->next = nullptr;
+      if (tail) {
+        tail->next = reqs[i];
+      } else {
+        head = reqs[i];
+      }
+      tail = reqs[i];
+    }
+  }
+  if (count == 1) {
+    cv.notify_one();
+  } else {
+    cv.notify_all();
+  }
+}
+
+void ThreadPoolIoEngine::WorkerLoop() {
+  std::unique_lock<std::mutex> lock(latch);
+  while (true) {
+    cv.wait(lock, [this]() { return stop || head; });
+    if (!head) {
+      break;
+    }
+    IoRequest *req = head;
+    head = req->next;
+    if (!head) {
+      tail = nullptr;
+    }
+    lock.unlock();
+
+    ssize_t ret = req->write ? pwrite(req->fd, req->buf, req->len, req->offset)
+                             : pread(req->fd, req->buf, req->len, req->offset);
+    req->result = ret < 0 ? -errno : ret;
+    req->callback(req);
+
+    lock.lock();
+  }
+}
+
+#ifdef YASE_HAVE_IO_URING
+
+// Registered buffers are limited to 1GB each, so larger regions are
+// registered as several of them
+static const size_t kFixedChunk = 1UL << 30;
+
+UringIoEngine::UringIoEngine()
+  : ring_fd(-1), sq_map(MAP_FAILED), sq_map_len(0), cq_map(MAP_FAILED), cq_map_len(0),
+    sqe_map(MAP_FAILED), sqe_map_len(0), entries(0), in_flight(0), pending_head(nullptr),
+    pending_tail(nullptr), fixed_base(nullptr), fixed_len(0) {}
+
+UringIoEngine *UringIoEngine::Create(uint32_t queue_depth) {
+  UringIoEngine *engine = new UringIoEngine();
+  if (!engine->Setup(queue_depth)) {
+    delete engine;
+    return nullptr;
+  }
+  engine->completer = std::thread(&UringIoEngine::CompletionLoop, engine);
+  return engine;
+}
+
+bool UringIoEngine::Setup(uint32_t queue_depth) {
+  struct io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  ring_fd = syscall(__NR_io_uring_setup, queue_depth, &params);
+  if (ring_fd < 0) {
+    return false;
+  }
+  entries = params.sq_entries;
+
+  sq_map_len = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+  cq_map_len = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+  if (single_mmap) {
+    sq_map_len = cq_map_len = std::max(sq_map_len, cq_map_len);
+  }
+  sq_map = mmap(nullptr, sq_map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                ring_fd, IORING_OFF_SQ_RING);
+  if (sq_map == MAP_FAILED) {
+    return false;
+  }
+  if (single_mmap) {
+    cq_map = sq_map;
+  } else {
+    cq_map = mmap(nullptr, cq_map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                  ring_fd, IORING_OFF_CQ_RING);
+    if (cq_map == MAP_FAILED) {
+      return false;
+    }
+  }
+  sqe_map_len = params.sq_entries * sizeof(struct io_uring_sqe);
+  sqe_map = mmap(nullptr, sqe_map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                 ring_fd, IORING_OFF_SQES);
+  if (sqe_map == MAP_FAILED) {
+    return false;
+  }
+
+  char *sq = (char *)sq_map;
+  char *cq = (char *)cq_map;
+  sq_head = (std::atomic<uint32_t> *)(sq + params.sq_off.head);
+  sq_tail = (std::atomic<uint32_t> *)(sq + params.sq_off.tail);
+  sq_mask = *(uint32_t *)(sq + params.sq_off.ring_mask);
+  sq_array = (uint32_t *)(sq + params.sq_off.array);
+  cq_head = (std::atomic<uint32_t> *)(cq + params.cq_off.head);
+  cq_tail = (std::atomic<uint32_t> *)(cq + params.cq_off.tail);
+  cq_mask = *(uint32_t *)(cq + params.cq_off.ring_mask);
+  cqes = cq + params.cq_off.cqes;
+  sqes = sqe_map;
+  return true;
+}
+
+UringIoEngine::~UringIoEngine() {
+  if (completer.joinable()) {
+    // Let everything in flight complete, then wake the completion thread up
+    // with a no-op carrying no request
+    std::unique_lock<std::mutex> lock(latch);
+    idle_cv.wait(lock, [this]() { return in_flight == 0 && !pending_head; });
+    uint32_t tail = sq_tail->load(std::memory_order_relaxed);
+    struct io_uring_sqe *sqe = &((struct io_uring_sqe *)sqes)[tail & sq_mask];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_NOP;
+    sqe->user_data = 0;
+    sq_array[tail & sq_mask] = tail & sq_mask;
+    sq_tail->store(tail + 1, std::memory_order_release);
+    int ret = syscall(__NR_io_uring_enter, ring_fd, 1, 0, 0, nullptr, 0);
+    LOG_IF(FATAL, ret < 0) << "Failed stopping io_uring completion thread";
+    lock.unlock();
+    completer.join();
+  }
+
+  if (sqe_map != MAP_FAILED) {
+    munmap(sqe_map, sqe_map_len);
+  }
+  if (cq_map != MAP_FAILED && cq_map != sq_map) {
+    munmap(cq_map, cq_map_len);
+  }
+  if (sq_map != MAP_FAILED) {
+    munmap(sq_map, sq_map_len);
+  }
+  if (ring_fd >= 0) {
+    close(ring_fd);
+  }
+}
+
+bool UringIoEngine::RegisterBuffers(void *base, size_t len) {
+  std::lock_guard<std::mutex> lock(latch);
+  if (fixed_base) {
+    return false;
+  }
+  std::vector<struct iovec> iovs;
+  for (size_t off = 0; off < len; off += kFixedChunk) {
+    iovs.push_back(iovec{(char *)base + off, std::min(kFixedChunk, len - off)});
+  }
+  // Fails, e.g., if the region exceeds RLIMIT_MEMLOCK; plain reads and
+  // writes still work then
+  int ret = syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_BUFFERS,
+                    iovs.data(), iovs.size());
+  if (ret < 0) {
+    return false;
+  }
+  fixed_base = (char *)base;
+  fixed_len = len;
+  return true;
+}
+
+void UringIoEngine::Submit(IoRequest **reqs, uint32_t count) {
+  if (count == 0) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(latch);
+  for (uint32_t i = 0; i < count; ++i) {
+    reqs[i]->next = nullptr;
+    if (pending_tail) {
+      pending_tail->next = reqs[i];
+    } else {
+      pending_head = reqs[i];
+    }
+    pending_tail = reqs[i];
+  }
+  IssuePending();
+}
+
+void UringIoEngine::IssuePending() {
+  uint32_t tail = sq_tail->load(std::memory_order_relaxed);
+  uint32_t issued = 0;
+  while (pending_head && in_flight < entries) {
+    IoRequest *req = pending_head;
+    pending_head = req->next;
+    if (!pending_head) {
+      pending_tail = nullptr;
+    }
+
+    uint32_t idx = (tail + issued) & sq_mask;
+    struct io_uring_sqe *sqe = &((struct io_uring_sqe *)sqes)[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->fd = req->fd;
+    sqe->addr = (uint64_t)req->buf;
+    sqe->len = req->len;
+    sqe->off = req->offset;
+    sqe->user_data = (uint64_t)req;
+
+    // Use the registered buffers if the transfer lies within one of them
+    char *buf = (char *)req->buf;
+    size_t fixed_off = buf - fixed_base;
+    if (fixed_base && buf >= fixed_base && fixed_off + req->len <= fixed_len &&
+        fixed_off % kFixedChunk + req->len <= kFixedChunk) {
+      sqe->opcode = req->write ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+      sqe->buf_index = fixed_off / kFixedChunk;
+    } else {
+      sqe->opcode = req->write ? IORING_OP_WRITE : IORING_OP_READ;
+    }
+    sq_array[idx] = idx;
+    ++issued;
+    ++in_flight;
+  }
+  if (issued == 0) {
+    return;
+  }
+
+  // One system call for the whole batch
+  sq_tail->store(tail + issued, std::memory_order_release);
+  int ret;
+  do {
+    ret = syscall(__NR_io_uring_enter, ring_fd, issued, 0, 0, nullptr, 0);
+  } while (ret < 0 && errno == EINTR);
+  LOG_IF(FATAL, ret < 0) << "io_uring_enter failed: " << strerror(errno);
+}
+
+void UringIoEngine::CompletionLoop() {
+  while (true) {
+    int ret = syscall(__NR_io_uring_enter, ring_fd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+    LOG_IF(FATAL, ret < 0 && errno != EINTR) << "io_uring_enter failed: " << strerror(errno);
+
+    uint32_t head = cq_head->load(std::memory_order_relaxed);
+    uint32_t tail = cq_tail->load(std::memory_order_acquire);
+    uint32_t reaped = 0;
+    bool stop = false;
+    for (; head != tail; ++head) {
+      struct io_uring_cqe *cqe = &((struct io_uring_cqe *)cqes)[head & cq_mask];
+      IoRequest *req = (IoRequest *)cqe->user_data;
+      int32_t res = cqe->res;
+      if (!req) {
+        stop = true;
+        continue;
+      }
+      ++reaped;
+      req->result = res;
+      req->callback(req);
+    }
+    cq_head->store(head, std::memory_order_release);
+
+    if (reaped) {
+      std::lock_guard<std::mutex> lock(latch);
+      in_flight -= reaped;
+      IssuePending();
+      if (in_flight == 0 && !pending_head) {
+        idle_cv.notify_all();
+      }
+    }
+    if (stop) {
+      break;
+    }
+  }
+}
+
+#else
+
+UringIoEngine *UringIoEngine::Create(uint32_t queue_depth) {
+  return nullptr;
+}
+
+#endif  // YASE_HAVE_IO_URING
+
+}  // namespace yase
@@ -0,0 +1,170 @@
+/*
+ * YASE: Yet Another Storage Engine
+ *
+ * CMPT 454 Database Systems II, Spring 2025
+ *
+ * Copyright (C) School of Computing Science, Simon Fraser University
+ *
+ * Not for distribution without prior approval.
+ */
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace yase {
+
+// An asynchronous read or write of one contiguous buffer. The submitter owns
+// the request and must keep it alive until its callback has run.
+struct IoRequest {
+  // File descriptor, offset and buffer of the transfer
+  int fd;
+  bool write;
+  void *buf;
+  uint32_t len;
+  uint64_t offset;
+
+  // Number of bytes transferred, or -errno; set before the callback runs
+  int64_t result;
+
+  // Called from an engine thread once the request completed
+  void (*callback)(IoRequest *req);
+
+  // For use by the submitter, e.g., to find its context in the callback
+  void *arg;
+
+  // Next request waiting to be issued; used by the engine
+  IoRequest *next;
+
+  IoRequest() : fd(-1), write(false), buf(nullptr), len(0), offset(0), result(0),
+                callback(nullptr), arg(nullptr), next(nullptr) {}
+
+  inline bool Succeeded() { return result == (int64_t)len; }
+};
+
+// Asynchronous I/O engine. Requests are submitted in batches and complete in
+// the background, in any order. The io_uring engine issues a whole batch with
+// one system call; where io_uring is not available, a pool of threads doing
+// pread/pwrite stands in for it.
+struct IoEngine {
+  enum Backend {
+    Auto,        // io_uring if the kernel supports it, otherwise ThreadPool
+    Uring,
+    ThreadPool,
+  };
+
+  static constexpr uint32_t kDefaultQueueDepth = 128;
+  static constexpr uint32_t kDefaultThreads = 4;
+
+  // Create an engine; returns nullptr if [backend] is not available
+  // @backend: backend to use
+  // @queue_depth: maximum number of requests in flight at a time; further
+  //               requests wait in the engine until earlier ones complete
+  static IoEngine *Create(Backend backend = Auto, uint32_t queue_depth = kDefaultQueueDepth);
+
+  virtual ~IoEngine() {}
+
+  // Start [count] requests; never blocks on I/O
+  virtual void Submit(IoRequest **reqs, uint32_t count) = 0;
+
+  // Register a memory region that will hold I/O buffers for the engine's
+  // lifetime (e.g., the buffer pool frames), so transfers into it skip the
+  // per-request mapping of user pages. Returns false if not supported.
+  virtual bool RegisterBuffers(void *base, size_t len) { return false; }
+
+  // Start [count] requests and wait for all of them; their callbacks and
+  // args are overwritten. Returns the number of successful requests.
+  uint32_t SubmitAndWait(IoRequest **reqs, uint32_t count);
+
+  virtual Backend GetBackend() = 0;
+};
+
+// Thread pool fallback: each worker performs one blocking pread/pwrite at a
+// time
+struct ThreadPoolIoEngine : public IoEngine {
+  ThreadPoolIoEngine(uint32_t thread_count);
+  ~ThreadPoolIoEngine();
+
+  void Submit(IoRequest **reqs, uint32_t count) override;
+  inline Backend GetBackend() override { return ThreadPool; }
+
+  void WorkerLoop();
+
+  std::mutex latch;
+  std::condition_variable cv;
+  bool stop;
+
+  // Queued requests, linked through IoRequest::next
+  IoRequest *head;
+  IoRequest *tail;
+
+  std::vector<std::thread> workers;
+};
+
+// io_uring engine, driven through the raw system calls: submitters fill the
+// submission ring under a latch, a completion thread reaps the completion
+// ring and runs the callbacks
+struct UringIoEngine : public IoEngine {
+  // Returns nullptr if io_uring cannot be set up
+  static UringIoEngine *Create(uint32_t queue_depth);
+  ~UringIoEngine();
+
+  void Submit(IoRequest **reqs, uint32_t count) override;
+  bool RegisterBuffers(void *base, size_t len) override;
+  inline Backend GetBackend() override { return Uring; }
+
+  UringIoEngine();
+  bool Setup(uint32_t queue_depth);
+
+  // Move waiting requests into the submission ring as long as there is room,
+  // and tell the kernel about them. Caller must hold latch.
+  void IssuePending();
+
+  void CompletionLoop();
+
+  // Ring file descriptor and mappings
+  int ring_fd;
+  void *sq_map;
+  size_t sq_map_len;
+  void *cq_map;
+  size_t cq_map_len;
+  void *sqe_map;
+  size_t sqe_map_len;
+
+  // Pointers into the mapped rings
+  std::atomic<uint32_t> *sq_head;
+  std::atomic<uint32_t> *sq_tail;
+  uint32_t sq_mask;
+  uint32_t *sq_array;
+  std::atomic<uint32_t> *cq_head;
+  std::atomic<uint32_t> *cq_tail;
+  uint32_t cq_mask;
+  void *cqes;
+  void *sqes;
+
+  // Number of submission ring entries; at most this many requests are in
+  // flight, so the completion ring never overflows
+  uint32_t entries;
+
+  // Protects the submission side and the fields below
+  std::mutex latch;
+  std::condition_variable idle_cv;
+  uint32_t in_flight;
+
+  // Requests waiting for room in the ring, linked through IoRequest::next
+  IoRequest *pending_head;
+  IoRequest *pending_tail;
+
+  // Registered buffer region, if any
+  char *fixed_base;
+  size_t fixed_len;
+
+  std::thread completer;
+};
+
+}  // namespace yase
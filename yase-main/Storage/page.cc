@@ -7,33 +7,66 @@
  *
  * Not for distribution without prior approval.
  */
+#include <algorithm>
+#include <vector>
 #include "page.h"
 
 namespace yase {
 
-bool DataPage::Insert(const char *record, uint32_t &out_slot_id) {
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__,
+              "Bitmap words are assumed to be little-endian");
+
+template <uint32_t kPageSize>
+uint32_t DataPageT<kPageSize>::FindFreeSlot(uint32_t from, uint32_t to) {
+  // The bitmap runs backwards from the end of data (slot 0 is in the last
+  // byte), so the eight bytes of 64 slots are loaded and byte-swapped
+  static constexpr uint32_t kBitmapEnd = sizeof(data);
+  for (uint32_t word = from / 64; word * 64 < to; ++word) {
+    uint64_t bits;
+    memcpy(&bits, &data[kBitmapEnd - (word + 1) * 8], sizeof(bits));
+    uint64_t free_bits = ~__builtin_bswap64(bits);
+    if (word == from / 64) {
+      free_bits &= ~uint64_t{0} << (from % 64);
+    }
+    if (free_bits) {
+      // Bits past [to] belong to records; don't trust them
+      return std::min<uint32_t>(word * 64 + __builtin_ctzll(free_bits), to);
+    }
+  }
+  return to;
+}
+
+template <uint32_t kPageSize>
+bool DataPageT<kPageSize>::Insert(const char *record, uint32_t &out_slot_id, uint16_t *hint) {
   auto max_slots = GetCapacity(record_size);
   if (record_count + 1 > max_slots) {
     return false;
   }
 
-  // Search through the space to find a free slot
-  for (uint32_t i = 0; i < max_slots; ++i) {
-    if (!SlotOccupied(i)) {
-      SetBitArray(i, true);
-      LOG_IF(FATAL, !SlotOccupied(i)) << "Failed setting bit array";
-
-      out_slot_id = i;
-      uint32_t off = i * record_size;
-      memcpy(&data[off], record, record_size);
-      ++record_count;
-      return true;
+  // Search from the hint on, then wrap around in case the hint is stale
+  uint32_t start = hint && *hint < max_slots ? *hint : 0;
+  uint32_t i = FindFreeSlot(start, max_slots);
+  if (i == max_slots) {
+    i = FindFreeSlot(0, start);
+    if (i == start) {
+      return false;
     }
   }
-  return false;
+  SetBitArray(i, true);
+  LOG_IF(FATAL, !SlotOccupied(i)) << "Failed setting bit array";
+
+  out_slot_id = i;
+  uint32_t off = i * record_size;
+  memcpy(&data[off], record, record_size);
+  ++record_count;
+  if (hint) {
+    *hint = i + 1;
+  }
+  return true;
 }
 
-bool DataPage::Read(RID rid, void *out_buf) {
+template <uint32_t kPageSize>
+bool DataPageT<kPageSize>::Read(RID rid, void *out_buf) {
   if (!SlotOccupied(rid.GetSlotId())) {
     return false;
   }
@@ -42,7 +75,8 @@ bool DataPage::Read(RID rid, void *out_buf) {
   return true;
 }
 
-bool DataPage::Delete(RID rid) {
+template <uint32_t kPageSize>
+bool DataPageT<kPageSize>::Delete(RID rid) {
   if (!SlotOccupied(rid.GetSlotId())) {
     return false;
   }
@@ -53,7 +87,8 @@ bool DataPage::Delete(RID rid) {
   return true;
 }
 
-bool DataPage::Update(RID rid, const char *record) {
+template <uint32_t kPageSize>
+bool DataPageT<kPageSize>::Update(RID rid, const char *record) {
   if (!SlotOccupied(rid.GetSlotId())) {
     return false;
   }
@@ -62,14 +97,16 @@ bool DataPage::Update(RID rid, const char *record) {
   return true;
 }
 
-bool DataPage::SlotOccupied(uint16_t slot_id) {
-  char &byte = data[PAGE_SIZE - sizeof(record_size) - sizeof(record_count) - slot_id / 8 - 1];
+template <uint32_t kPageSize>
+bool DataPageT<kPageSize>::SlotOccupied(uint16_t slot_id) {
+  char &byte = data[kPageSize - sizeof(record_size) - sizeof(record_count) - slot_id / 8 - 1];
   uint32_t pos = slot_id % 8;
   return byte & (uint8_t{1} << pos);
 }
 
-void DataPage::SetBitArray(uint32_t slot_id, bool value) {
-  uint32_t idx = PAGE_SIZE - sizeof(record_size) - sizeof(record_count) - slot_id / 8 - 1;
+template <uint32_t kPageSize>
+void DataPageT<kPageSize>::SetBitArray(uint32_t slot_id, bool value) {
+  uint32_t idx = kPageSize - sizeof(record_size) - sizeof(record_count) - slot_id / 8 - 1;
   char &byte = data[idx];
   uint32_t pos = slot_id % 8;
   if (value) {
@@ -81,10 +118,317 @@ void DataPage::SetBitArray(uint32_t slot_id, bool value) {
   }
 }
 
-uint16_t DataPage::GetCapacity(uint16_t record_size) {
+template <uint32_t kPageSize>
+uint16_t DataPageT<kPageSize>::GetCapacity(uint16_t record_size) {
   uint32_t bits_per_record = record_size * 8 + 1;
-  uint16_t nrecs = (PAGE_SIZE - sizeof(record_size) - sizeof(record_count)) * 8 / bits_per_record;
+  uint16_t nrecs = (kPageSize - sizeof(record_size) - sizeof(record_count)) * 8 / bits_per_record;
   return nrecs;
 }
 
+template <uint32_t kPageSize>
+bool SlottedPageT<kPageSize>::Insert(const char *record, uint16_t length, uint32_t &out_slot_id,
+                                     bool overflow) {
+  if (length == 0 || length > GetCapacity()) {
+    return false;
+  }
+
+  // Reuse a free slot if there is one, or add one to the directory
+  Slot *slots = GetSlots();
+  uint32_t slot = 0;
+  while (slot < slot_count && slots[slot].length != 0) {
+    ++slot;
+  }
+  uint32_t needed = length + (slot == slot_count ? sizeof(Slot) : 0);
+  uint32_t dir_end = (char *)&slots[slot_count] - (char *)this;
+  if (free_end - dir_end < needed) {
+    if (free_end - dir_end + fragmented < needed) {
+      return false;
+    }
+    Compact();
+  }
+
+  if (slot == slot_count) {
+    ++slot_count;
+  }
+  free_end -= length;
+  memcpy((char *)this + free_end, record, length);
+  slots[slot].offset = free_end;
+  slots[slot].length = length;
+  slots[slot].overflow = overflow;
+  ++record_count;
+  out_slot_id = slot;
+  return true;
+}
+
+template <uint32_t kPageSize>
+const char *SlottedPageT<kPageSize>::GetRecord(RID rid, uint16_t *out_length,
+                                               bool *out_overflow) {
+  uint32_t slot = rid.GetSlotId();
+  if (slot >= slot_count || GetSlots()[slot].length == 0) {
+    return nullptr;
+  }
+  *out_length = GetSlots()[slot].length;
+  if (out_overflow) {
+    *out_overflow = GetSlots()[slot].overflow;
+  }
+  return (char *)this + GetSlots()[slot].offset;
+}
+
+template <uint32_t kPageSize>
+bool SlottedPageT<kPageSize>::Delete(RID rid) {
+  uint32_t slot_id = rid.GetSlotId();
+  Slot *slots = GetSlots();
+  if (slot_id >= slot_count || slots[slot_id].length == 0) {
+    return false;
+  }
+
+  // The record next to the free space joins it right away
+  Slot &slot = slots[slot_id];
+  if (slot.offset == free_end) {
+    free_end += slot.length;
+  } else {
+    fragmented += slot.length;
+  }
+  slot.length = 0;
+  slot.overflow = 0;
+  --record_count;
+
+  // Free slots at the end of the directory go back to the free space
+  while (slot_count > 0 && slots[slot_count - 1].length == 0) {
+    --slot_count;
+  }
+  return true;
+}
+
+template <uint32_t kPageSize>
+bool SlottedPageT<kPageSize>::Update(RID rid, const char *new_record, uint16_t length,
+                                     bool overflow) {
+  uint32_t slot_id = rid.GetSlotId();
+  Slot *slots = GetSlots();
+  if (length == 0 || length > GetCapacity() || slot_id >= slot_count ||
+      slots[slot_id].length == 0) {
+    return false;
+  }
+
+  Slot &slot = slots[slot_id];
+  if (length <= slot.length) {
+    memcpy((char *)this + slot.offset, new_record, length);
+    fragmented += slot.length - length;
+    slot.length = length;
+    slot.overflow = overflow;
+    return true;
+  }
+
+  // Move the record: its old space counts as a hole
+  uint32_t dir_end = (char *)&slots[slot_count] - (char *)this;
+  if (free_end - dir_end + fragmented + slot.length < length) {
+    return false;
+  }
+  fragmented += slot.length;
+  slot.length = 0;
+  if (free_end - dir_end < length) {
+    Compact();
+  }
+  free_end -= length;
+  memcpy((char *)this + free_end, new_record, length);
+  slot.offset = free_end;
+  slot.length = length;
+  slot.overflow = overflow;
+  return true;
+}
+
+template <uint32_t kPageSize>
+void SlottedPageT<kPageSize>::Compact() {
+  // Slide records to the end of the page, highest first; a record never
+  // moves down, so it can't overwrite one that has yet to move
+  Slot *slots = GetSlots();
+  std::vector<uint16_t> order;
+  order.reserve(record_count);
+  for (uint16_t i = 0; i < slot_count; ++i) {
+    if (slots[i].length != 0) {
+      order.push_back(i);
+    }
+  }
+  std::sort(order.begin(), order.end(),
+            [slots](uint16_t a, uint16_t b) { return slots[a].offset > slots[b].offset; });
+
+  uint32_t end = kPageSize;
+  for (uint16_t i : order) {
+    end -= slots[i].length;
+    memmove((char *)this + end, (char *)this + slots[i].offset, slots[i].length);
+    slots[i].offset = end;
+  }
+  free_end = end;
+  fragmented = 0;
+}
+
+template <uint32_t kPageSize>
+uint16_t SlottedPageT<kPageSize>::GetFreeSpace() {
+  Slot *slots = GetSlots();
+  uint32_t dir_end = (char *)&slots[slot_count] - (char *)this;
+  uint32_t free = free_end - dir_end + fragmented;
+  bool free_slot = record_count < slot_count;
+  if (!free_slot) {
+    free = free > sizeof(Slot) ? free - sizeof(Slot) : 0;
+  }
+  return std::min<uint32_t>(free, GetCapacity());
+}
+
+template <uint32_t kPageSize>
+uint32_t PaxPageT<kPageSize>::GetLayoutSize(const uint16_t *widths, uint16_t field_count,
+                                            uint32_t capacity) {
+  uint32_t size = GetMinipageStart(field_count, capacity);
+  for (uint16_t i = 0; i < field_count; ++i) {
+    size += AlignMinipage(capacity * widths[i]);
+  }
+  return size;
+}
+
+template <uint32_t kPageSize>
+uint16_t PaxPageT<kPageSize>::GetCapacity(const uint16_t *widths, uint16_t field_count) {
+  if (field_count == 0 || field_count > kMaxFields) {
+    return 0;
+  }
+  uint32_t record_size = 0;
+  for (uint16_t i = 0; i < field_count; ++i) {
+    if (widths[i] == 0) {
+      return 0;
+    }
+    record_size += widths[i];
+  }
+  if (record_size > UINT16_MAX) {
+    return 0;
+  }
+
+  // Start from the capacity ignoring alignment (a record takes its bytes and
+  // a bit), then give up records until the padding fits too
+  uint32_t capacity = std::min<uint32_t>(kPageSize * 8 / (record_size * 8 + 1), UINT16_MAX);
+  while (capacity > 0 && GetLayoutSize(widths, field_count, capacity) > kPageSize) {
+    --capacity;
+  }
+  return capacity;
+}
+
+template <uint32_t kPageSize>
+PaxPageT<kPageSize>::PaxPageT(const uint16_t *widths, uint16_t field_count)
+  : record_count(0), record_size(0), capacity(GetCapacity(widths, field_count)),
+    field_count(field_count), data{0} {
+  LOG_IF(FATAL, capacity == 0) << "Unsupported PAX schema";
+  uint32_t offset = GetMinipageStart(field_count, capacity);
+  for (uint16_t i = 0; i < field_count; ++i) {
+    GetWidths()[i] = widths[i];
+    GetOffsets()[i] = offset;
+    offset += AlignMinipage(capacity * widths[i]);
+    record_size += widths[i];
+  }
+}
+
+template <uint32_t kPageSize>
+uint32_t PaxPageT<kPageSize>::FindFreeSlot(uint32_t from, uint32_t to) {
+  uint64_t *bitmap = GetBitmap();
+  for (uint32_t word = from / 64; word * 64 < to; ++word) {
+    uint64_t free_bits = ~bitmap[word];
+    if (word == from / 64) {
+      free_bits &= ~uint64_t{0} << (from % 64);
+    }
+    if (free_bits) {
+      // Bits past the capacity are never set
+      return std::min<uint32_t>(word * 64 + __builtin_ctzll(free_bits), to);
+    }
+  }
+  return to;
+}
+
+template <uint32_t kPageSize>
+bool PaxPageT<kPageSize>::Insert(const char *record, uint32_t &out_slot_id, uint16_t *hint) {
+  if (record_count >= capacity) {
+    return false;
+  }
+
+  // Search from the hint on, then wrap around in case the hint is stale
+  uint32_t start = hint && *hint < capacity ? *hint : 0;
+  uint32_t i = FindFreeSlot(start, capacity);
+  if (i == capacity) {
+    i = FindFreeSlot(0, start);
+    if (i == start) {
+      return false;
+    }
+  }
+  GetBitmap()[i / 64] |= uint64_t{1} << (i % 64);
+  out_slot_id = i;
+  ++record_count;
+  if (hint) {
+    *hint = i + 1;
+  }
+  return Update(RID(PageId(0, 0), i), record);
+}
+
+template <uint32_t kPageSize>
+bool PaxPageT<kPageSize>::Read(RID rid, void *out_buf) {
+  uint32_t slot = rid.GetSlotId();
+  if (slot >= capacity || !SlotOccupied(slot)) {
+    return false;
+  }
+  char *out = (char *)out_buf;
+  for (uint16_t i = 0; i < field_count; ++i) {
+    uint16_t width = GetWidths()[i];
+    memcpy(out, (char *)this + GetOffsets()[i] + slot * width, width);
+    out += width;
+  }
+  return true;
+}
+
+template <uint32_t kPageSize>
+bool PaxPageT<kPageSize>::Update(RID rid, const char *new_record) {
+  uint32_t slot = rid.GetSlotId();
+  if (slot >= capacity || !SlotOccupied(slot)) {
+    return false;
+  }
+  for (uint16_t i = 0; i < field_count; ++i) {
+    uint16_t width = GetWidths()[i];
+    memcpy((char *)this + GetOffsets()[i] + slot * width, new_record, width);
+    new_record += width;
+  }
+  return true;
+}
+
+template <uint32_t kPageSize>
+bool PaxPageT<kPageSize>::Delete(RID rid) {
+  uint32_t slot = rid.GetSlotId();
+  if (slot >= capacity || !SlotOccupied(slot)) {
+    return false;
+  }
+  GetBitmap()[slot / 64] &= ~(uint64_t{1} << (slot % 64));
+  --record_count;
+  return true;
+}
+
+template <uint32_t kPageSize>
+PaxColumn PaxPageT<kPageSize>::GetColumn(uint16_t field) {
+  PaxColumn column;
+  column.values = (char *)this + GetOffsets()[field];
+  column.width = GetWidths()[field];
+  column.slot_count = capacity;
+  column.occupied = GetBitmap();
+  return column;
+}
+
+template struct DataPageT<4096>;
+template struct DataPageT<8192>;
+template struct DataPageT<16384>;
+template struct DataPageT<32768>;
+template struct DataPageT<65536>;
+
+template struct SlottedPageT<4096>;
+template struct SlottedPageT<8192>;
+template struct SlottedPageT<16384>;
+template struct SlottedPageT<32768>;
+template struct SlottedPageT<65536>;
+
+template struct PaxPageT<4096>;
+template struct PaxPageT<8192>;
+template struct PaxPageT<16384>;
+template struct PaxPageT<32768>;
+template struct PaxPageT<65536>;
+
 }  // namespace yase
@@ -9,17 +9,36 @@
  */
 #pragma once
 
+#include <algorithm>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
 #include <glog/logging.h>
 
 #include "../yase_internal.h"
 
 namespace yase {
 
-struct DataPage {
+// Supported page sizes: powers of two from kMinPageSize to kMaxPageSize.
+// Each file picks its data page size; directory pages are always PAGE_SIZE.
+static constexpr uint32_t kMinPageSize = 4096;
+static constexpr uint32_t kMaxPageSize = 65536;
+inline bool IsValidPageSize(uint32_t page_size) {
+  return page_size >= kMinPageSize && page_size <= kMaxPageSize &&
+         (page_size & (page_size - 1)) == 0;
+}
+static_assert(PAGE_SIZE >= kMinPageSize && PAGE_SIZE <= kMaxPageSize &&
+              (PAGE_SIZE & (PAGE_SIZE - 1)) == 0, "Unsupported default page size");
+
+// Data page of kPageSize bytes; instantiated for every supported page size
+template <uint32_t kPageSize>
+struct DataPageT {
   // Data area, including actual data that starts from data[0], and the bit array
   // (excluding record count) that precedes record count and record size
   // information which are at the end of the page
-  char data[PAGE_SIZE - sizeof(uint16_t) * 2];
+  char data[kPageSize - sizeof(uint16_t) * 2];
 
   // Number of valid records (occupied slots), located at the end of the page
   uint16_t record_count;
@@ -30,8 +49,8 @@ struct DataPage {
   // Set the bit in the bit arrary for the given slot ID
   void SetBitArray(uint32_t slot_id, bool value);
 
-  DataPage() : data{0}, record_count(0), record_size(0) {}
-  DataPage(uint16_t record_size) : data{0}, record_count(0), record_size(record_size) {}
+  DataPageT() : data{0}, record_count(0), record_size(0) {}
+  DataPageT(uint16_t record_size) : data{0}, record_count(0), record_size(record_size) {}
 
   // Returns true if the given slot is occupied
   bool SlotOccupied(uint16_t slot);
@@ -39,8 +58,16 @@ struct DataPage {
   // Retrieve a record with a given RID from the page 
   bool Read(RID rid, void *out_buf);
 
+  // Return the record in [slot], in place; valid while the page is latched
+  inline const char *GetRecord(uint16_t slot) { return &data[slot * record_size]; }
+
   // Insert a new record
-  bool Insert(const char *record, uint32_t &out_slot_id);
+  // @hint: if given, the search for a free slot starts at *hint, which is
+  //        then moved past the slot taken; a wrong hint only costs time
+  bool Insert(const char *record, uint32_t &out_slot_id, uint16_t *hint = nullptr);
+
+  // Return the first free slot in [from, to); [to] if there is none
+  uint32_t FindFreeSlot(uint32_t from, uint32_t to);
 
   // Delete a record by a given RID
   bool Delete(RID rid);
@@ -55,20 +82,401 @@ struct DataPage {
   inline uint16_t GetRecordCount() { return record_count; }
 };
 
-// Directory page that consists of Entries, each Entry represents a data page
-struct DirectoryPage {
-  struct Entry {
-    uint16_t free_slots;
-    bool allocated;
-    bool created;
-    Entry() : allocated(false), created(false) {}
+// Data page of the default size
+typedef DataPageT<PAGE_SIZE> DataPage;
+
+// Record size that makes a file hold variable-length records in slotted
+// pages (see SlottedPageT) instead of fixed-size records in DataPages
+static constexpr uint16_t kVariableRecordSize = 0;
+
+// Slotted data page of kPageSize bytes for variable-length records. The
+// slot directory (offset/length pairs) grows from the header at the start of
+// the page and records are packed from the end, with the free space in
+// between. Deleting or shrinking records leaves holes, which are squeezed out
+// by compacting the page once a record doesn't fit otherwise; slot IDs (and
+// so RIDs) stay the same.
+template <uint32_t kPageSize>
+struct SlottedPageT {
+  // Longest record a slot can describe
+  static constexpr uint16_t kMaxLength = 0x7fff;
+
+  struct Slot {
+    // Offset of the record in the page
+    uint16_t offset;
+
+    // Length of the record; records are never empty, free slots have 0
+    uint16_t length : 15;
+
+    // The record is an OverflowHeader: the record itself is in overflow
+    // pages
+    uint16_t overflow : 1;
   };
 
-  Entry entries[PAGE_SIZE / sizeof(Entry)];
+  // Number of slots in the directory, used or free
+  uint16_t slot_count;
+
+  // Number of records (used slots)
+  uint16_t record_count;
+
+  // Records occupy [free_end, kPageSize); zero in a page never formatted
+  uint32_t free_end;
+
+  // Bytes of the holes among the records
+  uint32_t fragmented;
+
+  // Slot directory, then free space, then records
+  char data[kPageSize - sizeof(uint16_t) * 2 - sizeof(uint32_t) * 2];
+
+  SlottedPageT() : slot_count(0), record_count(0), free_end(kPageSize), fragmented(0) {}
+
+  // Insert a new record of [length] bytes; returns false if it doesn't fit
+  // @overflow: the record is an OverflowHeader
+  bool Insert(const char *record, uint16_t length, uint32_t &out_slot_id,
+              bool overflow = false);
+
+  // Return the record with a given RID and its length in [out_length];
+  // nullptr if there is no such record. Valid while the page is latched.
+  // @out_overflow: if given, set to whether the record is an OverflowHeader
+  const char *GetRecord(RID rid, uint16_t *out_length, bool *out_overflow = nullptr);
+
+  // Delete a record by a given RID
+  bool Delete(RID rid);
+
+  // Replace a record with one of [length] bytes, in place; returns false if
+  // there is no such record or the new one doesn't fit in the page
+  // @overflow: the new record is an OverflowHeader
+  bool Update(RID rid, const char *new_record, uint16_t length, bool overflow = false);
+
+  // Move the records to the end of the page, so that the holes among them
+  // join the free space
+  void Compact();
+
+  // Return the length of the longest record that can be inserted
+  uint16_t GetFreeSpace();
+
+  // Return the length of the longest record an empty page can take
+  static uint16_t GetCapacity() {
+    return std::min<uint32_t>(sizeof(data) - sizeof(Slot), kMaxLength);
+  }
+
+  inline uint16_t GetRecordCount() { return record_count; }
+  inline bool IsFormatted() { return free_end != 0; }
+  inline Slot *GetSlots() { return (Slot *)data; }
+};
+
+// Inline part of a variable-length record too long for a slotted page,
+// kept in the record's slot (marked overflow, see SlottedPageT::Slot). The
+// record is in a chain of overflow pages (see OverflowPageT).
+struct OverflowHeader {
+  // Length of the record
+  uint64_t length;
+
+  // Page number of the first overflow page
+  uint32_t first_page;
+
+  // Number of overflow pages
+  uint32_t page_count;
+};
+
+// Overflow page of kPageSize bytes: a piece of a record too long for a
+// slotted page, the rest following in the next pages of the chain
+template <uint32_t kPageSize>
+struct OverflowPageT {
+  // In place of SlottedPageT::free_end, which is never beyond kPageSize, so
+  // overflow pages are told apart from slotted pages
+  static constexpr uint32_t kMarker = ~uint32_t{0};
+
+  // Next page of the last page of a chain
+  static constexpr uint32_t kNoNext = ~uint32_t{0};
+
+  // Page number of the next page of the chain
+  uint32_t next;
+
+  uint32_t marker;
+
+  // Bytes of the record in this page
+  uint32_t length;
+
+  uint32_t reserved;
+
+  char data[kPageSize - sizeof(uint32_t) * 4];
+
+  OverflowPageT(uint32_t next, uint32_t length)
+    : next(next), marker(kMarker), length(length), reserved(0) {}
+
+  inline bool IsOverflow() { return marker == kMarker; }
+
+  // Return the number of bytes of a record a page takes
+  static uint32_t GetCapacity() { return sizeof(data); }
+};
+
+// Field widths of the fixed-size records of a file with PAX pages (see
+// PaxPageT), in order; empty for files with row (DataPageT) or slotted pages
+typedef std::vector<uint16_t> Schema;
+
+// One page's worth of a field, as stored in a PAX page: the field of slot i
+// is at values + i * width, and valid if slot i is occupied (bit i % 64 of
+// occupied[i / 64])
+struct PaxColumn {
+  const char *values;
+  uint16_t width;
+
+  // Number of slots in the page, whether occupied or not
+  uint16_t slot_count;
+
+  const uint64_t *occupied;
+};
+
+// PAX data page of kPageSize bytes for fixed-size records: each field is
+// stored in a minipage of its own, so a scan touching some of the fields
+// reads only their minipages, each a contiguous array. The page describes
+// itself (field widths and minipage offsets follow the header), records are
+// read and written whole like in DataPageT, and slot IDs are assigned the
+// same way.
+template <uint32_t kPageSize>
+struct PaxPageT {
+  static constexpr uint16_t kMaxFields = 64;
+
+  // Minipages start at multiples of this offset, i.e., on cache lines
+  static constexpr uint32_t kMinipageAlignment = 64;
+
+  // Number of valid records (occupied slots)
+  uint16_t record_count;
+
+  // Sum of the field widths; zero in a page never formatted
+  uint16_t record_size;
+
+  // Number of slots, the same in every minipage
+  uint16_t capacity;
+
+  uint16_t field_count;
+
+  // Field widths, minipage offsets (from the start of the page), the
+  // occupied-slot bitmap, then the minipages
+  char data[kPageSize - sizeof(uint16_t) * 4];
+
+  PaxPageT() : record_count(0), record_size(0), capacity(0), field_count(0) {}
+
+  // Format an empty page for records of [field_count] fields of [widths]
+  PaxPageT(const uint16_t *widths, uint16_t field_count);
+
+  // Returns true if the given slot is occupied
+  inline bool SlotOccupied(uint16_t slot) {
+    return GetBitmap()[slot / 64] >> (slot % 64) & 1;
+  }
+
+  // Retrieve a record with a given RID from the page, gathering its fields
+  bool Read(RID rid, void *out_buf);
+
+  // Insert a new record, scattering its fields to their minipages
+  // @hint: as in DataPageT::Insert
+  bool Insert(const char *record, uint32_t &out_slot_id, uint16_t *hint = nullptr);
+
+  // Return the first free slot in [from, to); [to] if there is none
+  uint32_t FindFreeSlot(uint32_t from, uint32_t to);
+
+  // Delete a record by a given RID
+  bool Delete(RID rid);
+
+  // Update a record with the given RID
+  bool Update(RID rid, const char *new_record);
+
+  // Return the minipage of [field]
+  PaxColumn GetColumn(uint16_t field);
+
+  // Return the number of records of [field_count] fields of [widths] that
+  // fit in a page; 0 if there are no fields, too many, or an empty one
+  static uint16_t GetCapacity(const uint16_t *widths, uint16_t field_count);
+
+  // Bytes used by a page of [capacity] records of the given fields, the
+  // last minipage rounded up to kMinipageAlignment
+  static uint32_t GetLayoutSize(const uint16_t *widths, uint16_t field_count,
+                                uint32_t capacity);
+
+  inline uint16_t GetRecordSize() { return record_size; }
+  inline uint16_t GetRecordCount() { return record_count; }
+  inline uint16_t *GetWidths() { return (uint16_t *)data; }
+  inline uint16_t *GetOffsets() { return (uint16_t *)data + field_count; }
+  inline uint64_t *GetBitmap() { return (uint64_t *)&data[GetBitmapOffset(field_count)]; }
+
+  // Offset of the bitmap in data: past the widths and offsets, 8-byte aligned
+  inline static uint32_t GetBitmapOffset(uint16_t field_count) {
+    return (field_count * sizeof(uint16_t) * 2 + 7) / 8 * 8;
+  }
+
+  // Offset of the first minipage in the page: past the bitmap of [capacity]
+  // slots
+  inline static uint32_t GetMinipageStart(uint16_t field_count, uint32_t capacity) {
+    return AlignMinipage(sizeof(uint16_t) * 4 + GetBitmapOffset(field_count) +
+                         (capacity + 63) / 64 * sizeof(uint64_t));
+  }
+
+  inline static uint32_t AlignMinipage(uint32_t size) {
+    return (size + kMinipageAlignment - 1) / kMinipageAlignment * kMinipageAlignment;
+  }
+};
+
+// Call [fn] with [data] cast to the PageT (DataPageT, SlottedPageT or
+// PaxPageT) of [page_size], e.g.,
+//   VisitPage<SlottedPageT>(size, buf, [&](auto *sp) { return sp->Compact(); });
+template <template <uint32_t> class PageT, typename Fn>
+inline auto VisitPage(uint32_t page_size, void *data, Fn &&fn) {
+  switch (page_size) {
+    case 8192: return fn((PageT<8192> *)data);
+    case 16384: return fn((PageT<16384> *)data);
+    case 32768: return fn((PageT<32768> *)data);
+    case 65536: return fn((PageT<65536> *)data);
+    default:
+      LOG_IF(FATAL, page_size != 4096) << "Unsupported page size " << page_size;
+      return fn((PageT<4096> *)data);
+  }
+}
+
+// Call [fn] with [data] cast to the DataPageT of [page_size], e.g.,
+//   VisitDataPage(size, buf, [&](auto *dp) { return dp->Read(rid, out); });
+template <typename Fn>
+inline auto VisitDataPage(uint32_t page_size, void *data, Fn &&fn) {
+  return VisitPage<DataPageT>(page_size, data, std::forward<Fn>(fn));
+}
+
+// Maximum number of records of [record_size] in a data page of [page_size];
+// for kVariableRecordSize, the longest record a slotted page can take; with
+// a [schema], the records a PAX page holds
+inline uint16_t GetDataPageCapacity(uint32_t page_size, uint16_t record_size,
+                                    const Schema &schema = Schema()) {
+  if (!schema.empty()) {
+    return VisitPage<PaxPageT>(page_size, nullptr, [&](auto *pp) {
+      return std::remove_pointer_t<decltype(pp)>::GetCapacity(schema.data(), schema.size());
+    });
+  }
+  if (record_size == kVariableRecordSize) {
+    return VisitPage<SlottedPageT>(page_size, nullptr, [](auto *sp) {
+      return std::remove_pointer_t<decltype(sp)>::GetCapacity();
+    });
+  }
+  return VisitDataPage(page_size, nullptr, [record_size](auto *dp) {
+    return std::remove_pointer_t<decltype(dp)>::GetCapacity(record_size);
+  });
+}
+
+// Format [data] as an empty data page of [page_size] for [record_size]
+// records (a slotted page for kVariableRecordSize, a PAX page for [schema])
+inline void InitDataPage(uint32_t page_size, void *data, uint16_t record_size,
+                         const Schema &schema = Schema()) {
+  if (!schema.empty()) {
+    VisitPage<PaxPageT>(page_size, data, [&](auto *pp) {
+      new (pp) std::remove_pointer_t<decltype(pp)>(schema.data(), schema.size());
+    });
+    return;
+  }
+  if (record_size == kVariableRecordSize) {
+    VisitPage<SlottedPageT>(page_size, data, [](auto *sp) {
+      new (sp) std::remove_pointer_t<decltype(sp)>();
+    });
+    return;
+  }
+  VisitDataPage(page_size, data, [record_size](auto *dp) {
+    new (dp) std::remove_pointer_t<decltype(dp)>(record_size);
+  });
+}
+
+// Return true if [data] was formatted by InitDataPage, rather than reading
+// as zeros (e.g., allocated by File::AllocatePages)
+inline bool IsDataPageFormatted(uint32_t page_size, void *data, uint16_t record_size,
+                                const Schema &schema = Schema()) {
+  if (!schema.empty()) {
+    return VisitPage<PaxPageT>(page_size, data, [](auto *pp) { return pp->GetRecordSize() != 0; });
+  }
+  if (record_size == kVariableRecordSize) {
+    return VisitPage<SlottedPageT>(page_size, data, [](auto *sp) { return sp->IsFormatted(); });
+  }
+  return VisitDataPage(page_size, data, [](auto *dp) { return dp->GetRecordSize() != 0; });
+}
+
+// Directory page: one 4-bit entry per data page, two entries per byte (the
+// even one in the low half). An entry has the page's created and allocated
+// flags and a free-space class that tells roughly how full the page is.
+// Pages read as zeros are all "not created".
+struct DirectoryPage {
+  static constexpr uint32_t kEntryBits = 4;
+  static constexpr uint32_t kEntries = PAGE_SIZE * 8 / kEntryBits;
+
+  static constexpr uint8_t kCreated = 1;
+  static constexpr uint8_t kAllocated = 2;
+
+  // Free-space classes, in the upper two bits of an entry
+  static constexpr uint8_t kFull = 0;       // No free slot
+  static constexpr uint8_t kLow = 1;        // Up to half of the slots free
+  static constexpr uint8_t kHigh = 2;       // More than half free
+  static constexpr uint8_t kEmpty = 3;      // All slots free
+
+  // Deallocated pages are empty; their class tells whether the page still
+  // has space on storage (kEmpty) or was punched out (kHole)
+  static constexpr uint8_t kHole = kFull;
+
+  uint8_t entries[PAGE_SIZE];
+
+  inline uint8_t GetEntry(uint32_t i) { return (entries[i / 2] >> (i % 2 * 4)) & 0xf; }
+  inline void SetEntry(uint32_t i, uint8_t value) {
+    uint8_t shift = i % 2 * 4;
+    entries[i / 2] = (entries[i / 2] & ~(0xf << shift)) | (value << shift);
+  }
+
+  inline bool IsCreated(uint32_t i) { return GetEntry(i) & kCreated; }
+  inline bool IsAllocated(uint32_t i) { return GetEntry(i) & kAllocated; }
+  inline uint8_t GetFreeClass(uint32_t i) { return GetEntry(i) >> 2; }
+  inline void SetAllocated(uint32_t i, bool allocated) {
+    SetEntry(i, (GetEntry(i) & ~kAllocated) | (allocated ? kAllocated : 0));
+  }
+  inline void SetFreeClass(uint32_t i, uint8_t free_class) {
+    SetEntry(i, (GetEntry(i) & 0x3) | (free_class << 2));
+  }
+
+  // Free-space class of a page with [free_slots] out of [capacity] slots free
+  inline static uint8_t GetFreeClass(uint16_t free_slots, uint16_t capacity) {
+    if (free_slots == 0) {
+      return kFull;
+    }
+    if (free_slots >= capacity) {
+      return kEmpty;
+    }
+    return free_slots * 2 > capacity ? kHigh : kLow;
+  }
+
+  // Fewest free slots a page of [free_class] can have, out of [capacity]
+  inline static uint16_t GetMinFreeSlots(uint8_t free_class, uint16_t capacity) {
+    switch (free_class) {
+      case kFull:
+        return 0;
+      case kLow:
+        return 1;
+      case kHigh:
+        return capacity / 2 + 1;
+      default:
+        return capacity;
+    }
+  }
+};
 
-  static_assert(PAGE_SIZE % sizeof(Entry) == 0, "Page size not a multiple of Entry size");
+// Directory entry of the original format (four bytes per data page); only
+// used to convert old directories, see File::ConvertDirectory
+struct LegacyDirectoryEntry {
+  uint16_t free_slots;
+  bool allocated;
+  bool created;
 };
 
+static_assert(sizeof(DataPageT<4096>) == 4096, "Wrong data page size");
+static_assert(sizeof(DataPageT<65536>) == 65536, "Wrong data page size");
 static_assert(sizeof(DataPage) == PAGE_SIZE, "Wrong data page size");
+static_assert(sizeof(SlottedPageT<4096>) == 4096, "Wrong slotted page size");
+static_assert(sizeof(SlottedPageT<65536>) == 65536, "Wrong slotted page size");
+static_assert(sizeof(OverflowPageT<4096>) == 4096, "Wrong overflow page size");
+static_assert(sizeof(OverflowPageT<65536>) == 65536, "Wrong overflow page size");
+static_assert(offsetof(OverflowPageT<4096>, marker) == offsetof(SlottedPageT<4096>, free_end),
+              "Overflow page marker must overlap the slotted page's free_end");
+static_assert(sizeof(SlottedPageT<4096>::Slot) == 4, "Wrong slot size");
+static_assert(sizeof(PaxPageT<4096>) == 4096, "Wrong PAX page size");
+static_assert(sizeof(PaxPageT<65536>) == 65536, "Wrong PAX page size");
 static_assert(sizeof(DirectoryPage) == PAGE_SIZE, "Wrong dir page size");
 }  // namespace yase
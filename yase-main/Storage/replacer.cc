@@ -0,0 +1,368 @@
+/*
+ * YASE: Yet Another Storage Engine
+ *
+ * CMPT 454 Database Systems II, Spring 2025
+ *
+ * Copyright (C) School of Computing Science, Simon Fraser University
+ *
+ * Not for distribution without prior approval.
+ */
+#include "replacer.h"
+#include "buffer_manager.h"
+
+namespace yase {
+
+Replacer *Replacer::Create(Policy policy, Page *frames, uint32_t frame_count) {
+  switch (policy) {
+    case LRU:
+      return new LRUReplacer(frames, frame_count);
+    case Clock:
+      return new ClockReplacer(frames, frame_count);
+    case LRUK:
+      return new LRUKReplacer(frames, frame_count);
+    case TwoQ:
+      return new TwoQReplacer(frames, frame_count);
+    case ARC:
+      return new ARCReplacer(frames, frame_count);
+  }
+  LOG(FATAL) << "Unknown replacement policy";
+  return nullptr;
+}
+
+bool Replacer::IsEvictable(uint32_t frame_id) {
+  Page *page = &frames[frame_id];
+  return page->GetPageId().IsValid() && page->GetPinCount() == 0;
+}
+
+FrameList::FrameList(uint32_t frame_count)
+  : prev(frame_count, Page::kInvalidFrame), next(frame_count, Page::kInvalidFrame),
+    head(Page::kInvalidFrame), tail(Page::kInvalidFrame), size(0) {}
+
+void FrameList::PushBack(uint32_t frame_id) {
+  prev[frame_id] = tail;
+  next[frame_id] = Page::kInvalidFrame;
+  if (tail == Page::kInvalidFrame) {
+    head = frame_id;
+  } else {
+    next[tail] = frame_id;
+  }
+  tail = frame_id;
+  ++size;
+}
+
+void FrameList::Remove(uint32_t frame_id) {
+  if (prev[frame_id] == Page::kInvalidFrame) {
+    head = next[frame_id];
+  } else {
+    next[prev[frame_id]] = next[frame_id];
+  }
+  if (next[frame_id] == Page::kInvalidFrame) {
+    tail = prev[frame_id];
+  } else {
+    prev[next[frame_id]] = prev[frame_id];
+  }
+  prev[frame_id] = next[frame_id] = Page::kInvalidFrame;
+  --size;
+}
+
+uint32_t FrameList::FindEvictable(Replacer *replacer) {
+  for (uint32_t f = head; f != Page::kInvalidFrame; f = next[f]) {
+    if (replacer->IsEvictable(f)) {
+      return f;
+    }
+  }
+  return Page::kInvalidFrame;
+}
+
+GhostList::GhostList(uint32_t capacity)
+  : ids(std::max<uint32_t>(capacity, 1), PageId::kInvalidValue), head(0), used(0), size(0) {
+  index.reserve(ids.size());
+}
+
+void GhostList::Add(PageId pid) {
+  Take(pid);
+  if (used == ids.size()) {
+    // Full: the oldest slot (entry or hole) makes room
+    uint64_t &id = ids[head];
+    if (id != PageId::kInvalidValue) {
+      index.erase(id);
+      id = PageId::kInvalidValue;
+      --size;
+    }
+    head = (head + 1) % ids.size();
+    --used;
+  }
+  uint32_t slot = (head + used) % ids.size();
+  ids[slot] = pid.value;
+  index[pid.value] = slot;
+  ++used;
+  ++size;
+}
+
+bool GhostList::Take(PageId pid) {
+  auto it = index.find(pid.value);
+  if (it == index.end()) {
+    return false;
+  }
+  ids[it->second] = PageId::kInvalidValue;
+  index.erase(it);
+  --size;
+  return true;
+}
+
+void GhostList::DropOldest() {
+  // Holes at the head are dropped along the way
+  while (used > 0) {
+    uint64_t id = ids[head];
+    ids[head] = PageId::kInvalidValue;
+    head = (head + 1) % ids.size();
+    --used;
+    if (id != PageId::kInvalidValue) {
+      index.erase(id);
+      --size;
+      return;
+    }
+  }
+}
+
+ClockReplacer::ClockReplacer(Page *frames, uint32_t frame_count)
+  : Replacer(frames, frame_count), hand(0), referenced(new std::atomic<bool>[frame_count]) {
+  for (uint32_t i = 0; i < frame_count; ++i) {
+    referenced[i] = false;
+  }
+}
+
+uint32_t ClockReplacer::Evict() {
+  // The first revolution may only clear reference bits, the second one is
+  // then guaranteed to find any frame that stayed unpinned
+  for (uint64_t i = 0; i < 2 * (uint64_t)frame_count; ++i) {
+    uint32_t frame_id = hand;
+    hand = (hand + 1) % frame_count;
+
+    if (!IsEvictable(frame_id)) {
+      continue;
+    }
+    if (referenced[frame_id].load(std::memory_order_relaxed)) {
+      referenced[frame_id].store(false, std::memory_order_relaxed);
+      continue;
+    }
+    return frame_id;
+  }
+  return Page::kInvalidFrame;
+}
+
+LRUReplacer::LRUReplacer(Page *frames, uint32_t frame_count)
+  : Replacer(frames, frame_count), list(frame_count), in_list(frame_count, false) {}
+
+void LRUReplacer::RecordLoad(uint32_t frame_id) {
+  RecordAccess(frame_id);
+}
+
+void LRUReplacer::RecordAccess(uint32_t frame_id) {
+  std::lock_guard<std::mutex> lock(latch);
+  if (in_list[frame_id]) {
+    list.Remove(frame_id);
+  }
+  list.PushBack(frame_id);
+  in_list[frame_id] = true;
+}
+
+uint32_t LRUReplacer::Evict() {
+  std::lock_guard<std::mutex> lock(latch);
+  return list.FindEvictable(this);
+}
+
+void LRUReplacer::Remove(uint32_t frame_id) {
+  std::lock_guard<std::mutex> lock(latch);
+  if (in_list[frame_id]) {
+    list.Remove(frame_id);
+    in_list[frame_id] = false;
+  }
+}
+
+LRUKReplacer::LRUKReplacer(Page *frames, uint32_t frame_count)
+  : Replacer(frames, frame_count), now(0), history((size_t)frame_count * kK, 0),
+    keys(frame_count, 0) {}
+
+uint64_t LRUKReplacer::GetKey(uint32_t frame_id) {
+  // Pages with fewer than K references have infinite backward K-distance and
+  // are preferred; ties are broken by the least recent reference
+  uint64_t *h = &history[(size_t)frame_id * kK];
+  return h[kK - 1] != 0 ? kFullKey | h[kK - 1] : h[0];
+}
+
+void LRUKReplacer::RecordLoad(uint32_t frame_id) {
+  std::lock_guard<std::mutex> lock(latch);
+  if (keys[frame_id]) {
+    order.erase({keys[frame_id], frame_id});
+  }
+  uint64_t *h = &history[(size_t)frame_id * kK];
+  h[0] = ++now;
+  for (uint32_t i = 1; i < kK; ++i) {
+    h[i] = 0;
+  }
+  keys[frame_id] = GetKey(frame_id);
+  order.insert({keys[frame_id], frame_id});
+}
+
+void LRUKReplacer::RecordAccess(uint32_t frame_id) {
+  std::lock_guard<std::mutex> lock(latch);
+  if (!keys[frame_id]) {
+    return;
+  }
+  order.erase({keys[frame_id], frame_id});
+  uint64_t *h = &history[(size_t)frame_id * kK];
+  for (uint32_t i = kK - 1; i > 0; --i) {
+    h[i] = h[i - 1];
+  }
+  h[0] = ++now;
+  keys[frame_id] = GetKey(frame_id);
+  order.insert({keys[frame_id], frame_id});
+}
+
+uint32_t LRUKReplacer::Evict() {
+  std::lock_guard<std::mutex> lock(latch);
+  // Pinned frames are skipped in place
+  for (auto &entry : order) {
+    if (IsEvictable(entry.second)) {
+      return entry.second;
+    }
+  }
+  return Page::kInvalidFrame;
+}
+
+void LRUKReplacer::Remove(uint32_t frame_id) {
+  std::lock_guard<std::mutex> lock(latch);
+  if (keys[frame_id]) {
+    order.erase({keys[frame_id], frame_id});
+    keys[frame_id] = 0;
+  }
+  for (uint32_t i = 0; i < kK; ++i) {
+    history[(size_t)frame_id * kK + i] = 0;
+  }
+}
+
+// Queue sizes as suggested in the 2Q paper: A1in holds a quarter of the
+// frames, A1out remembers half as many pages as there are frames
+TwoQReplacer::TwoQReplacer(Page *frames, uint32_t frame_count)
+  : Replacer(frames, frame_count), kin(std::max<uint32_t>(frame_count / 4, 1)),
+    a1in(frame_count), am(frame_count), a1out(frame_count / 2), queue(frame_count, None) {}
+
+void TwoQReplacer::RecordLoad(uint32_t frame_id) {
+  std::lock_guard<std::mutex> lock(latch);
+  if (a1out.Take(frames[frame_id].GetPageId())) {
+    am.PushBack(frame_id);
+    queue[frame_id] = Am;
+  } else {
+    a1in.PushBack(frame_id);
+    queue[frame_id] = A1in;
+  }
+}
+
+void TwoQReplacer::RecordAccess(uint32_t frame_id) {
+  std::lock_guard<std::mutex> lock(latch);
+  // Re-references in A1in are considered correlated and do not promote
+  if (queue[frame_id] == Am) {
+    am.Remove(frame_id);
+    am.PushBack(frame_id);
+  }
+}
+
+uint32_t TwoQReplacer::Evict() {
+  std::lock_guard<std::mutex> lock(latch);
+  uint32_t victim = Page::kInvalidFrame;
+  if (a1in.size > kin) {
+    victim = a1in.FindEvictable(this);
+  }
+  if (victim == Page::kInvalidFrame) {
+    victim = am.FindEvictable(this);
+  }
+  if (victim == Page::kInvalidFrame) {
+    victim = a1in.FindEvictable(this);
+  }
+  return victim;
+}
+
+void TwoQReplacer::Remove(uint32_t frame_id) {
+  std::lock_guard<std::mutex> lock(latch);
+  if (queue[frame_id] == A1in) {
+    a1in.Remove(frame_id);
+    a1out.Add(frames[frame_id].GetPageId());
+  } else if (queue[frame_id] == Am) {
+    am.Remove(frame_id);
+  }
+  queue[frame_id] = None;
+}
+
+ARCReplacer::ARCReplacer(Page *frames, uint32_t frame_count)
+  : Replacer(frames, frame_count), p(0), t1(frame_count), t2(frame_count),
+    b1(frame_count), b2(frame_count), queue(frame_count, None) {}
+
+void ARCReplacer::RecordLoad(uint32_t frame_id) {
+  std::lock_guard<std::mutex> lock(latch);
+  PageId pid = frames[frame_id].GetPageId();
+  if (b1.Take(pid)) {
+    // Recently evicted from T1: favour recency
+    uint32_t delta = std::max<uint32_t>(b2.size / std::max<uint32_t>(b1.size, 1), 1);
+    p = std::min(frame_count, p + delta);
+    t2.PushBack(frame_id);
+    queue[frame_id] = T2;
+  } else if (b2.Take(pid)) {
+    // Recently evicted from T2: favour frequency
+    uint32_t delta = std::max<uint32_t>(b1.size / std::max<uint32_t>(b2.size, 1), 1);
+    p = p > delta ? p - delta : 0;
+    t2.PushBack(frame_id);
+    queue[frame_id] = T2;
+  } else {
+    // Keep |T1| + |B1| within the cache size
+    if (t1.size + b1.size >= frame_count && b1.size > 0) {
+      b1.DropOldest();
+    }
+    t1.PushBack(frame_id);
+    queue[frame_id] = T1;
+  }
+}
+
+void ARCReplacer::RecordAccess(uint32_t frame_id) {
+  std::lock_guard<std::mutex> lock(latch);
+  // A frame that was dropped meanwhile is in no list
+  if (queue[frame_id] == None) {
+    return;
+  }
+  if (queue[frame_id] == T1) {
+    t1.Remove(frame_id);
+  } else {
+    t2.Remove(frame_id);
+  }
+  t2.PushBack(frame_id);
+  queue[frame_id] = T2;
+}
+
+uint32_t ARCReplacer::Evict() {
+  std::lock_guard<std::mutex> lock(latch);
+  uint32_t victim = Page::kInvalidFrame;
+  if (t1.size > 0 && t1.size >= std::max<uint32_t>(p, 1)) {
+    victim = t1.FindEvictable(this);
+  }
+  if (victim == Page::kInvalidFrame) {
+    victim = t2.FindEvictable(this);
+  }
+  if (victim == Page::kInvalidFrame) {
+    victim = t1.FindEvictable(this);
+  }
+  return victim;
+}
+
+void ARCReplacer::Remove(uint32_t frame_id) {
+  std::lock_guard<std::mutex> lock(latch);
+  if (queue[frame_id] == T1) {
+    t1.Remove(frame_id);
+    b1.Add(frames[frame_id].GetPageId());
+  } else if (queue[frame_id] == T2) {
+    t2.Remove(frame_id);
+    b2.Add(frames[frame_id].GetPageId());
+  }
+  queue[frame_id] = None;
+}
+
+}  // namespace yase
@@ -0,0 +1,255 @@
+/*
+ * YASE: Yet Another Storage Engine
+ *
+ * CMPT 454 Database Systems II, Spring 2025
+ *
+ * Copyright (C) School of Computing Science, Simon Fraser University
+ *
+ * Not for distribution without prior approval.
+ */
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+#include "../yase_internal.h"
+
+namespace yase {
+
+struct Page;
+
+// Page replacement policy of the buffer pool. A replacer tracks the frames
+// holding pages and picks eviction victims among the unpinned ones; pinned
+// frames are skipped in place.
+//
+// RecordLoad/RecordAccess may be called concurrently with each other; Evict
+// is only called by one thread at a time (the buffer manager holds
+// buffer_mutex). RecordLoad and Remove are called while the frame's page_id
+// is valid, so policies can keep history of evicted pages.
+struct Replacer {
+  enum Policy {
+    LRU,    // Least recently used
+    Clock,  // CLOCK (second chance)
+    LRUK,   // LRU-2: evict the page with the oldest second-to-last access
+    TwoQ,   // 2Q: FIFO for pages seen once, LRU for pages seen again
+    ARC,    // Adaptive replacement cache
+  };
+
+  // Create a replacer implementing [policy]
+  // @frames: the buffer pool's frame descriptors
+  // @frame_count: number of frames
+  static Replacer *Create(Policy policy, Page *frames, uint32_t frame_count);
+
+  Replacer(Page *frames, uint32_t frame_count) : frames(frames), frame_count(frame_count) {}
+  virtual ~Replacer() {}
+
+  // A page has just been loaded into a (pinned) frame
+  virtual void RecordLoad(uint32_t frame_id) = 0;
+
+  // A buffered page has been pinned again
+  virtual void RecordAccess(uint32_t frame_id) = 0;
+
+  // Pick an unpinned frame holding a page to evict, without removing it.
+  // Returns Page::kInvalidFrame if every frame is pinned.
+  virtual uint32_t Evict() = 0;
+
+  // The page in a frame is being evicted or dropped
+  virtual void Remove(uint32_t frame_id) = 0;
+
+  // Return true if the frame holds a page and is not pinned
+  bool IsEvictable(uint32_t frame_id);
+
+  // The buffer pool's frame descriptors
+  Page *frames;
+
+  // Number of frames
+  uint32_t frame_count;
+};
+
+// Doubly-linked list of frames, threaded through per-frame link arrays so
+// that moving a frame around never allocates
+struct FrameList {
+  FrameList(uint32_t frame_count);
+
+  void PushBack(uint32_t frame_id);
+  void Remove(uint32_t frame_id);
+
+  // Return the first evictable frame from the head, or Page::kInvalidFrame
+  uint32_t FindEvictable(Replacer *replacer);
+
+  std::vector<uint32_t> prev;
+  std::vector<uint32_t> next;
+  uint32_t head;
+  uint32_t tail;
+  uint32_t size;
+};
+
+// Bounded FIFO of the IDs of recently evicted pages ("ghost" entries). Adding
+// to a full list forgets the oldest entry. Entries live in a ring, found
+// through a hash index; taking one leaves a hole that is skipped once it
+// reaches the head, so all operations are O(1) amortized.
+struct GhostList {
+  GhostList(uint32_t capacity);
+
+  void Add(PageId pid);
+
+  // Remove [pid] if present; returns true if it was found
+  bool Take(PageId pid);
+
+  // Forget the oldest entry
+  void DropOldest();
+
+  // Ring of page IDs, oldest at [head]; kInvalidValue marks a hole
+  std::vector<uint64_t> ids;
+  uint32_t head;
+
+  // Number of ring slots in use, holes included
+  uint32_t used;
+
+  // Number of entries
+  uint32_t size;
+
+  // Page ID - ring slot mapping
+  std::unordered_map<uint64_t, uint32_t> index;
+};
+
+// CLOCK (second chance) replacement. Each frame has a reference bit that is
+// set whenever the frame is pinned; the clock hand sweeps the frames,
+// clearing set bits and evicting the first unpinned frame whose bit is
+// already clear. Pins only set a bit, so hits never take a latch.
+struct ClockReplacer : public Replacer {
+  ClockReplacer(Page *frames, uint32_t frame_count);
+  ~ClockReplacer() {}
+
+  inline void RecordLoad(uint32_t frame_id) override { RecordAccess(frame_id); }
+  inline void RecordAccess(uint32_t frame_id) override {
+    if (!referenced[frame_id].load(std::memory_order_relaxed)) {
+      referenced[frame_id].store(true, std::memory_order_relaxed);
+    }
+  }
+  inline void Remove(uint32_t frame_id) override {
+    referenced[frame_id].store(false, std::memory_order_relaxed);
+  }
+  uint32_t Evict() override;
+
+  // Position of the clock hand
+  uint32_t hand;
+
+  // Reference bit of each frame
+  std::unique_ptr<std::atomic<bool>[]> referenced;
+};
+
+// Least recently used replacement
+struct LRUReplacer : public Replacer {
+  LRUReplacer(Page *frames, uint32_t frame_count);
+  ~LRUReplacer() {}
+
+  void RecordLoad(uint32_t frame_id) override;
+  void RecordAccess(uint32_t frame_id) override;
+  uint32_t Evict() override;
+  void Remove(uint32_t frame_id) override;
+
+  // Latch protecting the list
+  std::mutex latch;
+
+  // Frames holding pages, least recently used first
+  FrameList list;
+  std::vector<bool> in_list;
+};
+
+// LRU-K replacement with K = 2. Pages referenced only once since they were
+// loaded (e.g., by a scan) are evicted first, oldest first; among the others
+// the page whose second-to-last reference is the oldest goes first.
+struct LRUKReplacer : public Replacer {
+  static constexpr uint32_t kK = 2;
+
+  LRUKReplacer(Page *frames, uint32_t frame_count);
+  ~LRUKReplacer() {}
+
+  void RecordLoad(uint32_t frame_id) override;
+  void RecordAccess(uint32_t frame_id) override;
+  uint32_t Evict() override;
+  void Remove(uint32_t frame_id) override;
+
+  // Eviction order key of a frame: frames with fewer than kK references
+  // first (by their last reference), then the others by their kK-th most
+  // recent reference
+  static constexpr uint64_t kFullKey = uint64_t{1} << 63;
+  uint64_t GetKey(uint32_t frame_id);
+
+  // Latch protecting the history
+  std::mutex latch;
+
+  // Logical time, advanced on every reference
+  uint64_t now;
+
+  // Last kK reference times of each frame, most recent first; 0 = none
+  std::vector<uint64_t> history;
+
+  // Frames holding pages as (key, frame), in eviction order
+  std::set<std::pair<uint64_t, uint32_t>> order;
+
+  // Key of each frame in [order]; 0 if the frame isn't there
+  std::vector<uint64_t> keys;
+};
+
+// Full 2Q replacement (Johnson and Shasha). New pages enter the A1in FIFO;
+// pages evicted from A1in are remembered in the A1out ghost list, and only
+// pages referenced again while in A1out are promoted to the Am LRU list.
+// A scan therefore only cycles through A1in.
+struct TwoQReplacer : public Replacer {
+  TwoQReplacer(Page *frames, uint32_t frame_count);
+  ~TwoQReplacer() {}
+
+  void RecordLoad(uint32_t frame_id) override;
+  void RecordAccess(uint32_t frame_id) override;
+  uint32_t Evict() override;
+  void Remove(uint32_t frame_id) override;
+
+  enum Queue : uint8_t { None, A1in, Am };
+
+  // Latch protecting the queues
+  std::mutex latch;
+
+  // Target size of A1in
+  uint32_t kin;
+
+  FrameList a1in;
+  FrameList am;
+  GhostList a1out;
+  std::vector<Queue> queue;
+};
+
+// Adaptive replacement cache (Megiddo and Modha). T1 holds pages seen once
+// recently, T2 pages seen at least twice; ghost lists B1 and B2 remember
+// pages evicted from T1 and T2, and hits on them shift the target size of T1
+// towards recency or frequency.
+struct ARCReplacer : public Replacer {
+  ARCReplacer(Page *frames, uint32_t frame_count);
+  ~ARCReplacer() {}
+
+  void RecordLoad(uint32_t frame_id) override;
+  void RecordAccess(uint32_t frame_id) override;
+  uint32_t Evict() override;
+  void Remove(uint32_t frame_id) override;
+
+  enum Queue : uint8_t { None, T1, T2 };
+
+  // Latch protecting the lists
+  std::mutex latch;
+
+  // Target size of T1
+  uint32_t p;
+
+  FrameList t1;
+  FrameList t2;
+  GhostList b1;
+  GhostList b2;
+  std::vector<Queue> queue;
+};
+
+}  // namespace yase
@@ -13,13 +13,50 @@
 
 namespace yase {
 
-Table::Table(std::string name, uint32_t record_size)
-  : table_name(name), file(name, record_size), record_size(record_size) {
-  // Allocate a new page for the table
-  next_free_pid = file.AllocatePage();
+Table::Table(std::string name, uint32_t record_size, bool direct_io, uint32_t page_size,
+             bool open_existing, const Schema &schema)
+  : table_name(name), file(name, record_size, direct_io, page_size, open_existing, schema),
+    record_size(record_size) {
+  // Continue filling an existing table where there is space; allocate a new
+  // page for the table otherwise
+  next_free_pid = open_existing ? FindFreePage() : PageId();
+  if (!next_free_pid.IsValid()) {
+    next_free_pid = file.AllocatePage();
+  }
+}
+
+PageId Table::FindFreePage() {
+  return file.FindPageWithSpace();
+}
+
+uint16_t Table::GetFreeSpace(Page *p) {
+  if (IsVariable()) {
+    return VisitPage<SlottedPageT>(file.GetPageSize(), p->page_data,
+                                   [](auto *sp) { return sp->GetFreeSpace(); });
+  }
+  uint16_t record_count = VisitFixedPage(p, [](auto *dp) { return dp->GetRecordCount(); });
+  return file.page_capacity - record_count;
 }
 
 RID Table::Insert(const char *record) {
+  return Insert(record, record_size);
+}
+
+RID Table::Insert(const char *record, uint32_t length) {
+  if (IsVariable() ? length == 0 : length != record_size) {
+    return RID();
+  }
+  if (IsVariable() && length > file.page_capacity) {
+    return StreamInsert(length, [&record](char *buf, uint32_t n) {
+      memcpy(buf, record, n);
+      record += n;
+    });
+  }
+  return InsertSlot(record, length, false);
+}
+
+RID Table::InsertSlot(const char *record, uint32_t length, bool overflow) {
+
   // Obtain buffer manager instance 
 
   auto *bm = BufferManager::Get();
@@ -31,9 +68,24 @@ retry:
     return RID();
   }
   p->Lock();
-  DataPage *dp = p->GetDataPage();
+  if (!IsDataPageFormatted(file.GetPageSize(), p->page_data, record_size, file.schema)) {
+    // Allocated in bulk and never used; see File::AllocatePages
+    InitDataPage(file.GetPageSize(), p->page_data, record_size, file.schema);
+    p->free_slot_hint = 0;
+  }
   uint32_t slot = 0;
-  if (!dp->Insert(record, slot)) {
+  bool inserted;
+  if (IsVariable()) {
+    inserted = VisitPage<SlottedPageT>(file.GetPageSize(), p->page_data, [&](auto *sp) {
+      return sp->Insert(record, length, slot, overflow);
+    });
+  } else {
+    inserted = VisitFixedPage(p, [&](auto *dp) {
+      return dp->Insert(record, slot, &p->free_slot_hint);
+    });
+  }
+  if (!inserted) {
+    uint16_t free_space = GetFreeSpace(p);
     p->Unlock();
     bm->UnpinPage(p);
 
@@ -43,59 +95,48 @@ retry:
       goto retry;
     }
 
-    next_free_pid = file.AllocatePage();
+    // Fill space freed by deletes before growing the file. The map may be
+    // behind, so a page it offers can turn out full (or, for variable-length
+    // records, short of room); its entry is corrected here.
+    file.UpdateFreeSpace(local_free_pid.GetPageNum(), free_space);
+    next_free_pid = file.FindPageWithSpace(IsVariable() ? length : 1);
+    if (!next_free_pid.IsValid()) {
+      next_free_pid = file.AllocatePage();
+    }
     if (!next_free_pid.IsValid()) {
       return RID();
     }
     goto retry;
   }
 
-  RID new_rid = RID(next_free_pid, slot);
-  if (!LogManager::Get()->LogInsert(new_rid, record, record_size)) {
+  RID new_rid = RID(local_free_pid, slot);
+  if (!LogManager::Get()->LogInsert(new_rid, record, length)) {
     // Handle logging error (e.g., abort the operation)
     p->Unlock();
     bm->UnpinPage(p);
     return RID();
   }
 
+  // Update the page's free-space class in the directory while the page is
+  // still latched, so concurrent inserts and deletes apply theirs in order
+  bool success = file.SetFreeSlots(local_free_pid.GetPageNum(), GetFreeSpace(p));
   p->SetDirty(true);
   p->Unlock();
   bm->UnpinPage(p);
-
-  // Mark the slot allocation in directory page
-  static uint32_t entries_per_dir_page = PAGE_SIZE / sizeof(DirectoryPage::Entry);
-  uint32_t dir_page_num = (next_free_pid.GetPageNum() / entries_per_dir_page);
-  PageId dir_pid(file.GetDir()->GetId(), dir_page_num);
-  p = bm->PinPage(dir_pid);
-  if (!p) {
-    return RID();
-  }
-  p->Lock();
-  DirectoryPage *dirp = p->GetDirPage();
-
-  uint32_t idx = next_free_pid.GetPageNum() % entries_per_dir_page;
-
-  if (dirp->entries[idx].free_slots == 0) {
-    p->Unlock();
-    bm->UnpinPage(p);
+  if (!success) {
     return RID();
   }
 
-  if(slot != UINT32_MAX){
-    --dirp->entries[idx].free_slots;
-    p->SetDirty(true);
-  }
-
-  p->SetDirty(true);
-  p->Unlock();
-  bm->UnpinPage(p);
-
   return new_rid;
 }
 
 bool Table::Read(RID rid, void *out_buf) {
+  if (IsVariable()) {
+    // The caller can't tell how large the buffer must be
+    return false;
+  }
 
-  if (!rid.IsValid() || !file.PageExists(rid.GetPageNum())) {
+  if (!rid.IsValid() || !file.PageExists(PageId(rid.GetFileId(), rid.GetPageNum()))) {
     return false;
   }
 
@@ -108,14 +149,25 @@ bool Table::Read(RID rid, void *out_buf) {
   }
   p->Lock();
 
-  DataPage *dp = p->GetDataPage();
-  bool success = dp->Read(rid, out_buf);
+  bool success = VisitFixedPage(p, [&](auto *dp) { return dp->Read(rid, out_buf); });
   p->Unlock();
   bm->UnpinPage(p);
 
   return success;
 }
 
+bool Table::Read(RID rid, std::string *out_record) {
+  if (!IsVariable()) {
+    out_record->resize(record_size);
+    return Read(rid, &(*out_record)[0]);
+  }
+
+  out_record->clear();
+  return StreamRead(rid, [out_record](const char *buf, uint32_t n) {
+    out_record->append(buf, n);
+  });
+}
+
 bool Table::Delete(RID rid) {
   if (!rid.IsValid()) {
     return false;
@@ -128,63 +180,96 @@ bool Table::Delete(RID rid) {
   }
   p->Lock();
 
-  DataPage *dp = p->GetDataPage();
-
-  // Log before delete
-  bool success = LogManager::Get()->LogDelete(rid);
+  // Log before delete; an overflow page has no slots to delete from
+  bool success = !(IsVariable() && IsOverflowPage(p)) && LogManager::Get()->LogDelete(rid);
   
+  // Overflow pages of the record go once it's gone from its slot
+  OverflowHeader header;
+  bool overflow = false;
   if (success) {
-    success = dp->Delete(rid);
+    if (IsVariable()) {
+      success = VisitPage<SlottedPageT>(file.GetPageSize(), p->page_data, [&](auto *sp) {
+        uint16_t length = 0;
+        const char *record = sp->GetRecord(rid, &length, &overflow);
+        if (record && overflow) {
+          memcpy(&header, record, sizeof(header));
+        }
+        return sp->Delete(rid);
+      });
+    } else {
+      success = VisitFixedPage(p, [&](auto *dp) { return dp->Delete(rid); });
+    }
   }
   if(success){
     p->SetDirty(true);
+    p->free_slot_hint = std::min<uint16_t>(p->free_slot_hint, rid.GetSlotId());
+    success = file.SetFreeSlots(rid.GetPageNum(), GetFreeSpace(p));
   }
   
   p->Unlock();
   bm->UnpinPage(p);
-
-  if (success) {
-    uint32_t entries_per_dir_page = PAGE_SIZE / sizeof(DirectoryPage::Entry);
-    uint32_t dir_page_num = rid.GetPageNum() / entries_per_dir_page;
-    PageId dir_pid(file.GetDir()->GetId(), dir_page_num);
-    p = bm->PinPage(dir_pid);
-    if (!p) {
-      return false;
-    }
-    p->Lock();
-    DirectoryPage *dirp = p->GetDirPage();
-    uint32_t idx = rid.GetPageNum() % entries_per_dir_page;
-    if (dirp->entries[idx].free_slots < DataPage::GetCapacity(record_size)) {
-      ++dirp->entries[idx].free_slots;
-    } else{
-    }
-    p->SetDirty(true);
-    p->Unlock();
-    bm->UnpinPage(p);
+  if (success && overflow) {
+    success = FreeOverflow(header);
   }
 
   return success;
 }
 
 bool Table::Update(RID rid, const char *record) {
-  if (!rid.IsValid()) {
+  return Update(rid, record, record_size);
+}
+
+bool Table::Update(RID rid, const char *record, uint32_t length) {
+  if (!rid.IsValid() || (IsVariable() ? length == 0 : length != record_size)) {
     return false;
   }
 
+  // A record too long for a slotted page goes to new overflow pages first;
+  // its slot then takes the OverflowHeader
+  OverflowHeader new_header;
+  bool to_overflow = IsVariable() && length > file.page_capacity;
+  if (to_overflow) {
+    if (!WriteOverflow(length, [&record](char *buf, uint32_t n) {
+          memcpy(buf, record, n);
+          record += n;
+        }, &new_header)) {
+      return false;
+    }
+    record = (const char *)&new_header;
+    length = sizeof(new_header);
+  }
+
   auto *bm = BufferManager::Get();
   Page *p = bm->PinPage(PageId(rid.GetFileId(), rid.GetPageNum()));
   if (!p) {
+    if (to_overflow) {
+      FreeOverflow(new_header);
+    }
     return false;
   }
   p->Lock();
 
-  DataPage *dp = p->GetDataPage();
-
-  // log before update
-  bool success = LogManager::Get()->LogUpdate(rid, record, record_size);
+  // log before update; an overflow page has no slots to update
+  bool success = !(IsVariable() && IsOverflowPage(p)) &&
+                 LogManager::Get()->LogUpdate(rid, record, length);
 
+  OverflowHeader old_header;
+  bool from_overflow = false;
   if (success) {
-    success = dp->Update(rid, record);
+    if (IsVariable()) {
+      success = VisitPage<SlottedPageT>(file.GetPageSize(), p->page_data, [&](auto *sp) {
+        uint16_t old_length = 0;
+        const char *old_record = sp->GetRecord(rid, &old_length, &from_overflow);
+        if (old_record && from_overflow) {
+          memcpy(&old_header, old_record, sizeof(old_header));
+        }
+        return sp->Update(rid, record, length, to_overflow);
+      });
+      // The record's length, and with it the page's free space, may change
+      success = success && file.SetFreeSlots(rid.GetPageNum(), GetFreeSpace(p));
+    } else {
+      success = VisitFixedPage(p, [&](auto *dp) { return dp->Update(rid, record); });
+    }
   }
   if(success){
     p->SetDirty(true);
@@ -192,6 +277,210 @@ bool Table::Update(RID rid, const char *record) {
 
   p->Unlock();
   bm->UnpinPage(p);
+
+  // Drop whichever overflow pages the slot no longer refers to
+  if (success && from_overflow) {
+    success = FreeOverflow(old_header);
+  } else if (!success && to_overflow) {
+    FreeOverflow(new_header);
+  }
   return success;
 }
-}  // namespace yase
\ No newline at end of file
+
+bool Table::AllocateOverflow(uint64_t page_count, std::vector<uint32_t> *out_pages) {
+  out_pages->clear();
+  out_pages->reserve(page_count);
+  while (out_pages->size() < page_count) {
+    PageId pid = file.ScavengePage(true);
+    if (!pid.IsValid()) {
+      break;
+    }
+    out_pages->push_back(pid.GetPageNum());
+  }
+
+  // The rest in one run, so that reading a long record is mostly sequential
+  // I/O (and triggers read-ahead)
+  uint64_t rest = page_count - out_pages->size();
+  if (rest > 0) {
+    PageId first_pid = rest <= PageId::kMaxPageNum ? file.AllocatePages(rest, true) : PageId();
+    if (!first_pid.IsValid()) {
+      for (uint32_t page_num : *out_pages) {
+        file.DeallocatePage(PageId(file.GetId(), page_num));
+      }
+      return false;
+    }
+    for (uint32_t i = 0; i < rest; ++i) {
+      out_pages->push_back(first_pid.GetPageNum() + i);
+    }
+  }
+  return true;
+}
+
+bool Table::FreeOverflow(const OverflowHeader &header) {
+  auto *bm = BufferManager::Get();
+  uint32_t page_num = header.first_page;
+  for (uint32_t i = 0; i < header.page_count; ++i) {
+    PageId pid(file.GetId(), page_num);
+    Page *p = page_num == OverflowPageT<PAGE_SIZE>::kNoNext ? nullptr : bm->PinPage(pid);
+    if (!p) {
+      return false;
+    }
+    p->Lock();
+    bool valid = VisitPage<OverflowPageT>(file.GetPageSize(), p->page_data, [&](auto *op) {
+      page_num = op->next;
+      return op->IsOverflow();
+    });
+    p->Unlock();
+    bm->UnpinPage(p);
+    if (!valid || !file.DeallocatePage(pid)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+uint32_t Table::GetOverflowCapacity() {
+  return VisitPage<OverflowPageT>(file.GetPageSize(), nullptr, [](auto *op) {
+    return std::remove_pointer_t<decltype(op)>::GetCapacity();
+  });
+}
+
+bool Table::IsOverflowPage(Page *p) {
+  return VisitPage<OverflowPageT>(file.GetPageSize(), p->page_data,
+                                  [](auto *op) { return op->IsOverflow(); });
+}
+
+std::unique_ptr<TableScan> Table::Scan() {
+  return std::unique_ptr<TableScan>(new TableScan(this));
+}
+
+TableScan::TableScan(Table *table)
+  : table(table), next_page(0), dir_page_num(~uint32_t{0}), prefetched_end(0), page(nullptr) {}
+
+void TableScan::Close() {
+  if (page) {
+    page->Unlock();
+    BufferManager::Get()->UnpinPage(page);
+    page = nullptr;
+  }
+}
+
+bool TableScan::LoadDirectory(uint32_t dir_page_num) {
+  if (!table->file.GetAllocated(dir_page_num, &allocated)) {
+    return false;
+  }
+  this->dir_page_num = dir_page_num;
+  return true;
+}
+
+void TableScan::ReadAhead(uint32_t page_num) {
+  // Keep a window ahead, topped up once half of it has been scanned; it
+  // stops at the end of the cached directory page
+  if (page_num + kReadAheadPages / 2 < prefetched_end) {
+    return;
+  }
+  uint32_t dir_end = (dir_page_num + 1) * DirectoryPage::kEntries;
+  uint32_t end = std::min({page_num + kReadAheadPages, table->file.GetPageCount(), dir_end});
+  uint32_t start = std::max(page_num, prefetched_end);
+  auto *bm = BufferManager::Get();
+  while (start < end) {
+    // One request per run of allocated pages
+    while (start < end && !allocated[start % DirectoryPage::kEntries]) {
+      ++start;
+    }
+    uint32_t run_end = start;
+    while (run_end < end && allocated[run_end % DirectoryPage::kEntries]) {
+      ++run_end;
+    }
+    if (run_end > start) {
+      bm->Prefetch(PageId(table->file.GetId(), start), run_end - start);
+    }
+    start = run_end;
+  }
+  prefetched_end = std::max(prefetched_end, end);
+}
+
+void TableScan::GetRecords(Page *p, std::vector<ScanRecord> *out_batch) {
+  File &file = table->file;
+  PageId pid = p->GetPageId();
+  if (!IsDataPageFormatted(file.GetPageSize(), p->page_data, table->record_size, file.schema)) {
+    // Allocated in bulk and never used
+    return;
+  }
+
+  if (table->IsVariable()) {
+    if (table->IsOverflowPage(p)) {
+      // Holds a piece of a record, which is handed out with its slot
+      return;
+    }
+    VisitPage<SlottedPageT>(file.GetPageSize(), p->page_data, [&](auto *sp) {
+      for (uint32_t slot = 0; slot < sp->slot_count; ++slot) {
+        uint16_t length = 0;
+        bool overflow = false;
+        RID rid(pid, slot);
+        const char *record = sp->GetRecord(rid, &length, &overflow);
+        if (record && overflow) {
+          out_batch->push_back({rid, nullptr, (uint32_t)((OverflowHeader *)record)->length});
+        } else if (record) {
+          out_batch->push_back({rid, record, length});
+        }
+      }
+    });
+  } else if (table->IsPax()) {
+    // Records are spread over the minipages: gather them
+    VisitPage<PaxPageT>(file.GetPageSize(), p->page_data, [&](auto *pp) {
+      buffer.resize(pp->GetRecordCount() * table->record_size);
+      char *out = buffer.data();
+      for (uint32_t slot = 0; slot < pp->capacity; ++slot) {
+        RID rid(pid, slot);
+        if (pp->Read(rid, out)) {
+          out_batch->push_back({rid, out, table->record_size});
+          out += table->record_size;
+        }
+      }
+    });
+  } else {
+    VisitDataPage(file.GetPageSize(), p->page_data, [&](auto *dp) {
+      uint16_t capacity = dp->GetCapacity(dp->GetRecordSize());
+      for (uint32_t slot = 0; slot < capacity; ++slot) {
+        if (dp->SlotOccupied(slot)) {
+          out_batch->push_back({RID(pid, slot), dp->GetRecord(slot), table->record_size});
+        }
+      }
+    });
+  }
+}
+
+bool TableScan::Next(std::vector<ScanRecord> *out_batch) {
+  Close();
+  out_batch->clear();
+
+  auto *bm = BufferManager::Get();
+  while (next_page < table->file.GetPageCount()) {
+    uint32_t page_num = next_page++;
+    if (page_num / DirectoryPage::kEntries != dir_page_num &&
+        !LoadDirectory(page_num / DirectoryPage::kEntries)) {
+      return false;
+    }
+    if (!allocated[page_num % DirectoryPage::kEntries]) {
+      continue;
+    }
+    ReadAhead(page_num);
+
+    Page *p = bm->PinPage(PageId(table->file.GetId(), page_num));
+    if (!p) {
+      return false;
+    }
+    p->Lock();
+    GetRecords(p, out_batch);
+    if (!out_batch->empty()) {
+      page = p;
+      return true;
+    }
+    p->Unlock();
+    bm->UnpinPage(p);
+  }
+  return false;
+}
+
+}  // namespace yase
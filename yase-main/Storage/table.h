@@ -9,26 +9,71 @@
  */
 #pragma once
 
+#include <memory>
+#include <string>
+#include <vector>
+
 #include "page.h"
 #include "file.h"
+#include "buffer_manager.h"
+#include "Log/log_manager.h"
 
 namespace yase {
 
+struct TableScan;
+
 // User-facing table abstraction
 struct Table {
  public:
-  Table(std::string name, uint32_t record_size);
+  // @name: table name
+  // @record_size: size of the table's records; kVariableRecordSize for
+  //               variable-length records, kept in slotted pages (and
+  //               overflow pages for those longer than a page)
+  // @direct_io: access the table's files with direct I/O
+  // @page_size: size of the data pages (see page.h for the supported sizes);
+  //             larger pages suit larger records and sequential scans
+  // @open_existing: reopen the table's files with their contents, e.g., on
+  //                 restart; record and page size must be the same as before
+  // @schema: widths of the records' fields, adding up to [record_size], to
+  //          store them column by column in PAX pages (see ScanColumns);
+  //          must be the same as before when reopening
+  Table(std::string name, uint32_t record_size, bool direct_io = false,
+        uint32_t page_size = PAGE_SIZE, bool open_existing = false,
+        const Schema &schema = Schema());
   ~Table() {}
 
   // Insert a record to the table, returns the inserted record's RID
   // @record: pointer to the record
   RID Insert(const char *record);
 
-  // Read a record with a given RID
+  // Insert a record of [length] bytes; with fixed-size records, [length]
+  // must be the record size. Variable-length records longer than a slotted
+  // page can take (page_capacity) go to overflow pages. Returns an invalid
+  // RID if a variable-length record is empty.
+  RID Insert(const char *record, uint32_t length);
+
+  // Insert a variable-length record of [length] bytes without holding it in
+  // memory: [fill] is called as fill(char *buf, uint32_t n) to write the next
+  // n bytes of the record, straight into its overflow pages (records short
+  // enough to stay in a slotted page are buffered)
+  template <typename Fn>
+  RID StreamInsert(uint64_t length, Fn &&fill);
+
+  // Read a record piece by piece, without copying it whole: [consume] is
+  // called as consume(const char *buf, uint32_t n) with the next n bytes of
+  // the record, in order, while the page holding them is pinned and
+  // latched. Returns false if there is no such record.
+  template <typename Fn>
+  bool StreamRead(RID rid, Fn &&consume);
+
+  // Read a record with a given RID; only for fixed-size records
   // @rid: RID of the record to be read
   // @out_buf: memory provided by user to store the read record
   bool Read(RID rid, void *out_buf);
 
+  // Read a record with a given RID, of any length, into [out_record]
+  bool Read(RID rid, std::string *out_record);
+
   // Delete a record with the given RID
   // @rid: RID of the record to be deleted
   bool Delete(RID rid);
@@ -38,9 +83,81 @@ struct Table {
   // @record: pointer to the new record value
   bool Update(RID rid, const char *record);
 
+  // Update a record with one of [length] bytes. A variable-length record
+  // stays on its page (its RID doesn't change), so the update fails if the
+  // page has no room for the new length (or the OverflowHeader of a record
+  // moving to overflow pages).
+  bool Update(RID rid, const char *record, uint32_t length);
+
+  // Start a scan of all the table's records, in page order (see TableScan)
+  std::unique_ptr<TableScan> Scan();
+
+  // Return true if the table holds variable-length records
+  inline bool IsVariable() { return record_size == kVariableRecordSize; }
+
+  // Return true if the table's records are stored in PAX pages
+  inline bool IsPax() { return !file.schema.empty(); }
+
+  // Scan [fields] of a PAX table, page by page: [fn] is called with the
+  // PageId of each data page and an array of its minipages, one PaxColumn
+  // per field in [fields]. The page is pinned and latched during the call.
+  // Returns false if the table isn't PAX, a field doesn't exist or a page
+  // can't be read.
+  template <typename Fn>
+  bool ScanColumns(const std::vector<uint16_t> &fields, Fn &&fn);
+
+  // Call [fn] with latched data page [p] of fixed-size records, cast to the
+  // DataPageT or PaxPageT of the table's page size
+  template <typename Fn>
+  inline auto VisitFixedPage(Page *p, Fn &&fn) {
+    if (IsPax()) {
+      return VisitPage<PaxPageT>(file.GetPageSize(), p->page_data, std::forward<Fn>(fn));
+    }
+    return VisitDataPage(file.GetPageSize(), p->page_data, std::forward<Fn>(fn));
+  }
+
   // Return the ID of the underlying File
   inline int GetFileId() { return file.GetId(); }
 
+  // Find the lowest-numbered allocated page with free slots through the
+  // file's free-space map, without reading data pages; returns an invalid
+  // PageId if there is none
+  PageId FindFreePage();
+
+  // Free space of latched data page [p], as kept in the directory: free
+  // slots for fixed-size records, free bytes for variable-length ones
+  uint16_t GetFreeSpace(Page *p);
+
+  // Insert [length] bytes of [record] in a slot of a data page
+  // @overflow: the record is an OverflowHeader
+  RID InsertSlot(const char *record, uint32_t length, bool overflow);
+
+  // Allocate overflow pages for a record of [length] bytes and write it
+  // there with [fill] (see StreamInsert); the chain is described in
+  // [out_header]. Returns false, with no page left allocated, on failure.
+  template <typename Fn>
+  bool WriteOverflow(uint64_t length, Fn &&fill, OverflowHeader *out_header);
+
+  // Pass the record in the overflow pages of [header] to [consume] (see
+  // StreamRead); returns false if the chain is broken
+  template <typename Fn>
+  bool ReadOverflow(const OverflowHeader &header, Fn &&consume);
+
+  // Allocate [page_count] overflow pages into [out_pages]: deallocated pages
+  // first, then new ones in one run; returns false, with no page left
+  // allocated, if the file is full
+  bool AllocateOverflow(uint64_t page_count, std::vector<uint32_t> *out_pages);
+
+  // Deallocate the overflow pages of [header], following the chain
+  bool FreeOverflow(const OverflowHeader &header);
+
+  // Number of bytes of a record an overflow page of this table takes
+  uint32_t GetOverflowCapacity();
+
+  // Return true if latched data page [p] of a variable-length table is an
+  // overflow page, which has no slots a RID could refer to
+  bool IsOverflowPage(Page *p);
+
   // The table's name
   std::string table_name;
 
@@ -57,4 +174,262 @@ struct Table {
   std::mutex latch;
 };
 
+// A record handed out by TableScan
+struct ScanRecord {
+  RID rid;
+
+  // The record, in its page (or gathered, for PAX pages); nullptr if it is
+  // in overflow pages, to be read with Table::StreamRead
+  const char *record;
+
+  uint32_t length;
+};
+
+// Cursor over the records of a table, a data page at a time. It walks the
+// directory (each directory page is pinned once) to skip pages that aren't
+// allocated, prefetches the allocated pages ahead of it, and pins each data
+// page once, handing out all of the page's records in a batch:
+//
+//   auto scan = table.Scan();
+//   std::vector<ScanRecord> batch;
+//   while (scan->Next(&batch)) {
+//     for (auto &r : batch) ... r.record ...
+//   }
+//
+// The page of a batch stays pinned and latched until the next call to Next
+// or Close, so the table must not be modified by the scanning thread
+// meanwhile. Records added to or removed from other pages during the scan
+// may or may not be seen.
+struct TableScan {
+  // Pages to prefetch ahead of the scan
+  static constexpr uint32_t kReadAheadPages = BufferManager::kReadAheadPages;
+
+  TableScan(Table *table);
+  ~TableScan() { Close(); }
+
+  // Move to the next data page with records and put them in [out_batch]
+  // (cleared first). Returns false at the end of the table, or if a page
+  // can't be read.
+  bool Next(std::vector<ScanRecord> *out_batch);
+
+  // Release the page of the current batch, if any
+  void Close();
+
+  // Cache the allocated flags of the data pages of directory page
+  // [dir_page_num]; returns false if it can't be read
+  bool LoadDirectory(uint32_t dir_page_num);
+
+  // Prefetch the allocated pages in the read-ahead window of data page
+  // [page_num], if not done yet
+  void ReadAhead(uint32_t page_num);
+
+  // Add the records of latched data page [p] to [out_batch]
+  void GetRecords(Page *p, std::vector<ScanRecord> *out_batch);
+
+  Table *table;
+
+  // Next data page to look at
+  uint32_t next_page;
+
+  // Directory page whose entries are cached in [allocated]
+  uint32_t dir_page_num;
+  std::vector<bool> allocated;
+
+  // Pages before this have been prefetched
+  uint32_t prefetched_end;
+
+  // Page of the current batch, pinned and latched; nullptr if none
+  Page *page;
+
+  // Records of the current batch gathered from a PAX page
+  std::vector<char> buffer;
+};
+
+template <typename Fn>
+RID Table::StreamInsert(uint64_t length, Fn &&fill) {
+  if (!IsVariable() || length == 0) {
+    return RID();
+  }
+  if (length <= file.page_capacity) {
+    std::string record(length, 0);
+    fill(&record[0], (uint32_t)length);
+    return InsertSlot(record.data(), length, false);
+  }
+
+  OverflowHeader header;
+  if (!WriteOverflow(length, std::forward<Fn>(fill), &header)) {
+    return RID();
+  }
+  RID rid = InsertSlot((const char *)&header, sizeof(header), true);
+  if (!rid.IsValid()) {
+    FreeOverflow(header);
+  }
+  return rid;
+}
+
+template <typename Fn>
+bool Table::StreamRead(RID rid, Fn &&consume) {
+  if (!IsVariable()) {
+    std::string record;
+    if (!Read(rid, &record)) {
+      return false;
+    }
+    consume(record.data(), (uint32_t)record.size());
+    return true;
+  }
+
+  if (!rid.IsValid() || !file.PageExists(PageId(rid.GetFileId(), rid.GetPageNum()))) {
+    return false;
+  }
+  auto *bm = BufferManager::Get();
+  Page *p = bm->PinPage(PageId(rid.GetFileId(), rid.GetPageNum()));
+  if (!p) {
+    return false;
+  }
+  p->Lock();
+  uint16_t length = 0;
+  bool overflow = false;
+  OverflowHeader header;
+  const char *record = nullptr;
+  if (!IsOverflowPage(p)) {
+    record = VisitPage<SlottedPageT>(file.GetPageSize(), p->page_data, [&](auto *sp) {
+      return sp->GetRecord(rid, &length, &overflow);
+    });
+  }
+  if (record && overflow) {
+    memcpy(&header, record, sizeof(header));
+  } else if (record) {
+    consume(record, (uint32_t)length);
+  }
+  p->Unlock();
+  bm->UnpinPage(p);
+
+  if (!record) {
+    return false;
+  }
+  return !overflow || ReadOverflow(header, std::forward<Fn>(consume));
+}
+
+template <typename Fn>
+bool Table::WriteOverflow(uint64_t length, Fn &&fill, OverflowHeader *out_header) {
+  uint32_t capacity = GetOverflowCapacity();
+  uint64_t page_count = (length + capacity - 1) / capacity;
+  if (page_count == 0 || page_count > PageId::kMaxPageNum) {
+    return false;
+  }
+
+  std::vector<uint32_t> pages;
+  if (!AllocateOverflow(page_count, &pages)) {
+    return false;
+  }
+  out_header->length = length;
+  out_header->first_page = pages[0];
+  out_header->page_count = page_count;
+
+  auto *bm = BufferManager::Get();
+  for (uint32_t i = 0; i < page_count; ++i) {
+    PageId pid(file.GetId(), pages[i]);
+    Page *p = bm->PinPage(pid);
+    bool logged = false;
+    if (p) {
+      p->Lock();
+      uint32_t n = std::min<uint64_t>(capacity, length - (uint64_t)i * capacity);
+      uint32_t next = i + 1 < page_count ? pages[i + 1] : OverflowPageT<PAGE_SIZE>::kNoNext;
+      logged = VisitPage<OverflowPageT>(file.GetPageSize(), p->page_data, [&](auto *op) {
+        new (op) std::remove_pointer_t<decltype(op)>(next, n);
+        fill(op->data, n);
+        return LogManager::Get()->LogInsert(RID(pid, 0), op->data, n);
+      });
+      p->SetDirty(true);
+      p->Unlock();
+      bm->UnpinPage(p);
+    }
+    if (!logged) {
+      // The chain isn't linked up yet
+      for (uint32_t page_num : pages) {
+        file.DeallocatePage(PageId(file.GetId(), page_num));
+      }
+      return false;
+    }
+  }
+  return true;
+}
+
+template <typename Fn>
+bool Table::ReadOverflow(const OverflowHeader &header, Fn &&consume) {
+  auto *bm = BufferManager::Get();
+  uint64_t read = 0;
+  uint32_t page_num = header.first_page;
+  for (uint32_t i = 0; i < header.page_count; ++i) {
+    Page *p = page_num == OverflowPageT<PAGE_SIZE>::kNoNext
+                  ? nullptr : bm->PinPage(PageId(file.GetId(), page_num));
+    if (!p) {
+      return false;
+    }
+    p->Lock();
+    bool valid = VisitPage<OverflowPageT>(file.GetPageSize(), p->page_data, [&](auto *op) {
+      if (!op->IsOverflow() || op->length > op->GetCapacity()) {
+        return false;
+      }
+      consume((const char *)op->data, op->length);
+      read += op->length;
+      page_num = op->next;
+      return true;
+    });
+    p->Unlock();
+    bm->UnpinPage(p);
+    if (!valid) {
+      return false;
+    }
+  }
+  return read == header.length;
+}
+
+template <typename Fn>
+bool Table::ScanColumns(const std::vector<uint16_t> &fields, Fn &&fn) {
+  if (!IsPax()) {
+    return false;
+  }
+  for (uint16_t field : fields) {
+    if (field >= file.schema.size()) {
+      return false;
+    }
+  }
+
+  // Each directory page is read once for the data pages it covers
+  auto *bm = BufferManager::Get();
+  std::vector<PaxColumn> columns(fields.size());
+  std::vector<bool> allocated;
+  uint32_t page_count = file.GetPageCount();
+  for (uint32_t page_num = 0; page_num < page_count; ++page_num) {
+    uint32_t index = page_num % DirectoryPage::kEntries;
+    if (index == 0 || allocated.empty()) {
+      if (!file.GetAllocated(page_num / DirectoryPage::kEntries, &allocated)) {
+        return false;
+      }
+    }
+    if (!allocated[index]) {
+      continue;
+    }
+    PageId pid(file.GetId(), page_num);
+    Page *p = bm->PinPage(pid);
+    if (!p) {
+      return false;
+    }
+    p->Lock();
+    // Pages allocated in bulk and never used are still zeros
+    if (IsDataPageFormatted(file.GetPageSize(), p->page_data, record_size, file.schema)) {
+      VisitPage<PaxPageT>(file.GetPageSize(), p->page_data, [&](auto *pp) {
+        for (uint32_t i = 0; i < fields.size(); ++i) {
+          columns[i] = pp->GetColumn(fields[i]);
+        }
+      });
+      fn(pid, columns.data());
+    }
+    p->Unlock();
+    bm->UnpinPage(p);
+  }
+  return true;
+}
+
 }  // namespace yase
@@ -322,6 +322,30 @@ GTEST_TEST(LogManager, FlushUponCommit) {
   LOG_IF(FATAL, ret == -1) << "Error cleaning up testing files";
 }
 
+GTEST_TEST(LogManager, OpenExisting) {
+  static const uint32_t kRecordSize = 128;
+  yase::LogManager::Initialize("log_file", 1);
+  ASSERT_TRUE(yase::LogManager::Get()->LogInsert(yase::RID(0xbeef), tls_rec_arena, kRecordSize));
+  ASSERT_TRUE(yase::LogManager::Get()->Flush());
+  LogManager::LSN end = yase::LogManager::Get()->GetDurableLSN();
+  yase::LogManager::Uninitialize();
+
+  // New records are appended after the existing ones
+  yase::LogManager::Initialize("log_file", 1, true);
+  auto *log = yase::LogManager::Get();
+  ASSERT_EQ(log->GetDurableLSN(), end);
+  ASSERT_EQ(log->GetCurrentLSN(), end);
+  ASSERT_TRUE(log->LogCommit(1));
+  ASSERT_TRUE(log->Flush());
+  yase::LogManager::Uninitialize();
+
+  struct stat s;
+  ASSERT_EQ(stat("log_file", &s), 0);
+  ASSERT_EQ(s.st_size, end + sizeof(yase::LogRecord) + sizeof(yase::LogManager::LSN));
+  int ret = system("rm -rf log_file");
+  LOG_IF(FATAL, ret == -1) << "Error cleaning up testing files";
+}
+
 }  // namespace yase
 
 int main(int argc, char **argv) {
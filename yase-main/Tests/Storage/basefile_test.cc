@@ -11,6 +11,8 @@
  */
 
 #include <fcntl.h>
+#include <chrono>
+#include <iostream>
 #include <thread>
 #include <glog/logging.h>
 #include <gtest/gtest.h>
@@ -152,6 +154,172 @@ TEST_F(BaseFileTests, MultiThreadAccess) {
   ASSERT_EQ(s.st_size, kThreads * kPages * PAGE_SIZE);
 }
 
+// New pages come out of preallocated extents and read as zeros
+TEST_F(BaseFileTests, Preallocation) {
+  NewBaseFile();
+  for (uint32_t i = 0; i < yase::BaseFile::kMinExtentPages + 1; ++i) {
+    ASSERT_TRUE(bfile->CreatePage().IsValid());
+  }
+  if (!bfile->preallocate) {
+    GTEST_SKIP() << "fallocate not supported here";
+  }
+  ASSERT_GT(bfile->reserved_pages, yase::BaseFile::kMinExtentPages);
+
+  // The file size still covers exactly the created pages, while the space
+  // behind them is allocated
+  struct stat s;
+  stat(bfile_name.c_str(), &s);
+  ASSERT_EQ(s.st_size, (yase::BaseFile::kMinExtentPages + 1) * PAGE_SIZE);
+  ASSERT_GE((uint64_t)s.st_blocks * 512, (uint64_t)bfile->reserved_pages * PAGE_SIZE);
+
+  char page[PAGE_SIZE];
+  memset(page, 'x', PAGE_SIZE);
+  ASSERT_TRUE(bfile->LoadPage(yase::PageId(bfile->GetId(), yase::BaseFile::kMinExtentPages), page));
+  for (uint32_t i = 0; i < PAGE_SIZE; ++i) {
+    ASSERT_EQ(page[i], 0);
+  }
+}
+
+// Benchmark: creating pages for a bulk load
+TEST_F(BaseFileTests, CreateThroughput) {
+  static const uint32_t kPages = 16384;
+
+  NewBaseFile();
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < kPages; ++i) {
+    ASSERT_TRUE(bfile->CreatePage().IsValid());
+  }
+  double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  std::cout << "CreatePage: " << kPages / secs << " pages/s" << std::endl;
+}
+
+// Page IDs and RIDs keep file ID, page number and slot apart over their
+// whole ranges
+TEST(PageIdTests, Layout) {
+  yase::PageId pid(0xabcd, yase::PageId::kMaxPageNum);
+  ASSERT_TRUE(pid.IsValid());
+  ASSERT_EQ(pid.GetFileId(), 0xabcd);
+  ASSERT_EQ(pid.GetPageNum(), yase::PageId::kMaxPageNum);
+
+  yase::RID rid(yase::PageId(7, 70000), 0xffff);
+  ASSERT_EQ(rid.GetFileId(), 7);
+  ASSERT_EQ(rid.GetPageNum(), 70000);
+  ASSERT_EQ(rid.GetSlotId(), 0xffff);
+  ASSERT_NE(yase::PageId(1, 0).value, yase::PageId(0, 1 << 16).value);
+}
+
+// Pages far beyond 64K pages (and 4GB) are addressed correctly
+TEST_F(BaseFileTests, LargePageNumbers) {
+  static const uint32_t kFirstPage = (1 << 20) + 3;
+
+  // Pretend the file already has that many pages; it stays sparse
+  NewBaseFile();
+  bfile->page_count = kFirstPage;
+  bfile->reserved_pages = kFirstPage;
+  yase::PageId pid = bfile->CreatePage();
+  ASSERT_TRUE(pid.IsValid());
+  ASSERT_EQ(pid.GetPageNum(), kFirstPage);
+
+  char page[PAGE_SIZE];
+  memset(page, 'L', PAGE_SIZE);
+  ASSERT_TRUE(bfile->FlushPage(pid, page));
+  memset(page, 0, PAGE_SIZE);
+  ASSERT_TRUE(bfile->LoadPage(pid, page));
+  ASSERT_EQ(page[0], 'L');
+
+  struct stat s;
+  stat(bfile_name.c_str(), &s);
+  ASSERT_EQ((uint64_t)s.st_size, (uint64_t)(kFirstPage + 1) * PAGE_SIZE);
+
+  // Page numbers don't wrap around
+  bfile->page_count = yase::PageId::kMaxPageNum + 1;
+  ASSERT_FALSE(bfile->CreatePage().IsValid());
+  ASSERT_EQ(bfile->GetPageCount(), yase::PageId::kMaxPageNum + 1);
+}
+
+// Sync makes written pages durable
+TEST_F(BaseFileTests, Sync) {
+  NewBaseFile();
+  AccessFile(bfile, 2);
+  ASSERT_TRUE(bfile->Sync());
+}
+
+// Benchmark: page writes, synced once at the end like a checkpoint would
+TEST_F(BaseFileTests, FlushThroughput) {
+  static const uint32_t kPages = 256;
+  static const uint32_t kWrites = 4096;
+
+  NewBaseFile();
+  std::vector<yase::PageId> pids;
+  for (uint32_t i = 0; i < kPages; ++i) {
+    pids.push_back(bfile->CreatePage());
+  }
+
+  char page[PAGE_SIZE];
+  memset(page, 'x', PAGE_SIZE);
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < kWrites; ++i) {
+    ASSERT_TRUE(bfile->FlushPage(pids[i % kPages], page));
+  }
+  ASSERT_TRUE(bfile->Sync());
+  double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  std::cout << "FlushPage: " << kWrites / secs << " pages/s" << std::endl;
+}
+
+// Direct I/O bypasses the page cache; unaligned buffers still work
+TEST_F(BaseFileTests, DirectIO) {
+  bfile = new yase::BaseFile(bfile_name.c_str(), true);
+  if (!bfile->IsDirect()) {
+    GTEST_SKIP() << "Direct I/O not supported here";
+  }
+  ASSERT_TRUE(fcntl(bfile->GetId(), F_GETFL) & O_DIRECT);
+  ASSERT_EQ(PAGE_SIZE % bfile->GetIoAlignment(), 0);
+
+  // Unaligned buffers
+  AccessFile(bfile, 4);
+
+  // Aligned buffers
+  char *p = (char *)aligned_alloc(bfile->GetIoAlignment(), PAGE_SIZE);
+  ASSERT_NE(p, nullptr);
+  memset(p, 'x', PAGE_SIZE);
+  yase::PageId pid = bfile->CreatePage();
+  ASSERT_TRUE(bfile->FlushPage(pid, p));
+  memset(p, 0, PAGE_SIZE);
+  ASSERT_TRUE(bfile->LoadPage(pid, p));
+  ASSERT_EQ(p[0], 'x');
+  ASSERT_EQ(p[PAGE_SIZE - 1], 'x');
+  free(p);
+
+  struct stat s;
+  stat(bfile_name.c_str(), &s);
+  ASSERT_EQ(s.st_size, 5 * PAGE_SIZE);
+}
+
+// Reopening keeps the pages and derives the page count from the file size
+TEST_F(BaseFileTests, OpenExisting) {
+  NewBaseFile();
+  char page[PAGE_SIZE];
+  for (uint32_t i = 0; i < 3; ++i) {
+    yase::PageId pid = bfile->CreatePage();
+    memset(page, 'a' + i, PAGE_SIZE);
+    ASSERT_TRUE(bfile->FlushPage(pid, page));
+  }
+  delete bfile;
+
+  bfile = new yase::BaseFile(bfile_name.c_str(), false, PAGE_SIZE, true);
+  ASSERT_EQ(bfile->GetPageCount(), 3);
+  for (uint32_t i = 0; i < 3; ++i) {
+    ASSERT_TRUE(bfile->LoadPage(yase::PageId(bfile->GetId(), i), page));
+    ASSERT_EQ(page[PAGE_SIZE - 1], 'a' + i);
+  }
+  ASSERT_EQ(bfile->CreatePage().GetPageNum(), 3);
+
+  // Without open_existing the file starts over
+  delete bfile;
+  bfile = new yase::BaseFile(bfile_name.c_str());
+  ASSERT_EQ(bfile->GetPageCount(), 0);
+}
+
 int main(int argc, char **argv) {
   ::google::InitGoogleLogging(argv[0]);
   ::testing::InitGoogleTest(&argc, argv);
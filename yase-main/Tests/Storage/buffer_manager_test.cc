@@ -13,7 +13,10 @@
 #include <assert.h>
 #include <iostream>
 #include <memory>
+#include <chrono>
 #include <cstdio>
+#include <random>
+#include <thread>
 
 #include <glog/logging.h>
 #include <gtest/gtest.h>
@@ -54,7 +57,11 @@ TEST_F(BufferManagerTests, Init) {
     ASSERT_FALSE(p->is_dirty);
     ASSERT_EQ(p->pin_count, 0);
     ASSERT_EQ(p->page_id.value, yase::PageId().value);
+    ASSERT_EQ(p->frame_id, i);
+    ASSERT_EQ(p->page_data, bm->frame_data + i * PAGE_SIZE);
+    ASSERT_EQ((uintptr_t)p->page_data % PAGE_SIZE, 0);
   }
+  ASSERT_EQ(bm->size_classes[0].free_frames.size(), kPageCount);
 }
 
 // Register a BaseFile to the buffer manager
@@ -173,6 +180,583 @@ TEST_F(BufferManagerTests, Evict) {
   LOG_IF(FATAL, ret == -1) << "Error cleaning up testing files";
 }
 
+// Evicted pages hand their frame over to the new page
+TEST_F(BufferManagerTests, EvictReusesFrame) {
+  yase::BaseFile bf("test_reg");
+  NewBufferManager();
+  bm->RegisterFile(&bf);
+
+  yase::Page *first = nullptr;
+  for (uint32_t i = 0; i < kPageCount; ++i) {
+    yase::Page *p = bm->PinPage(bf.CreatePage());
+    ASSERT_NE(p, nullptr);
+    if (!first) {
+      first = p;
+    }
+  }
+  ASSERT_EQ(bm->size_classes[0].free_frames.size(), 0);
+
+  // The first page is the only unpinned one, so it is evicted
+  bm->UnpinPage(first);
+  yase::PageId pid = bf.CreatePage();
+  yase::Page *p = bm->PinPage(pid);
+  ASSERT_EQ(p, first);
+  ASSERT_EQ(p->page_id.value, pid.value);
+  ASSERT_EQ(p->pin_count, 1);
+
+  // Everything is pinned now
+  ASSERT_EQ(bm->PinPage(bf.CreatePage()), nullptr);
+
+  int ret = system("rm -rf test_reg");
+  LOG_IF(FATAL, ret == -1) << "Error cleaning up testing files";
+}
+
+// EvictPage writes a dirty page back and frees its frame, unless pinned
+TEST_F(BufferManagerTests, EvictPage) {
+  yase::BaseFile bf("test_reg");
+  NewBufferManager();
+  bm->RegisterFile(&bf);
+
+  yase::PageId pid = bf.CreatePage();
+  ASSERT_TRUE(bm->EvictPage(pid));
+  yase::Page *p = bm->PinPage(pid);
+  ASSERT_NE(p, nullptr);
+  memset(p->page_data, 'e', PAGE_SIZE);
+  p->SetDirty(true);
+  ASSERT_FALSE(bm->EvictPage(pid));
+  bm->UnpinPage(p);
+
+  uint32_t free_frames = bm->size_classes[0].free_frames.size();
+  ASSERT_TRUE(bm->EvictPage(pid));
+  ASSERT_EQ(bm->size_classes[0].free_frames.size(), free_frames + 1);
+  ASSERT_FALSE(p->page_id.IsValid());
+  char buf[PAGE_SIZE];
+  ASSERT_TRUE(bf.LoadPage(pid, buf));
+  ASSERT_EQ(buf[PAGE_SIZE - 1], 'e');
+
+  int ret = system("rm -rf test_reg");
+  LOG_IF(FATAL, ret == -1) << "Error cleaning up testing files";
+}
+
+// The page cleaner writes dirty unpinned pages back in the background
+TEST_F(BufferManagerTests, Cleaner) {
+  yase::BaseFile bf("test_reg");
+  NewBufferManager();
+  bm->RegisterFile(&bf);
+
+  // Dirty every frame, keeping one page pinned
+  std::vector<yase::PageId> pids;
+  yase::Page *pinned = nullptr;
+  for (uint32_t i = 0; i < kPageCount; ++i) {
+    pids.push_back(bf.CreatePage());
+    yase::Page *p = bm->PinPage(pids.back());
+    ASSERT_NE(p, nullptr);
+    memset(p->page_data, i + 1, PAGE_SIZE);
+    p->SetDirty(true);
+    if (i == 0) {
+      pinned = p;
+    } else {
+      bm->UnpinPage(p);
+    }
+  }
+
+  // Clean everything as soon as anything is dirty. Pages are marked clean
+  // before being written, so also wait for the cleaner to unpin them.
+  auto busy = [&]() {
+    uint32_t pinned_count = 0;
+    for (uint32_t i = 0; i < kPageCount; ++i) {
+      pinned_count += bm->page_frames[i].pin_count > 0;
+    }
+    return bm->dirty_count > 1 || pinned_count > 1;
+  };
+  bm->SetDirtyWatermarks(0, 0);
+  for (uint32_t i = 0; i < 500 && busy(); ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  ASSERT_FALSE(busy());
+  ASSERT_TRUE(pinned->IsDirty());
+  ASSERT_EQ(bm->dirty_count, 1);
+
+  // Unpinned pages reached storage
+  char buf[PAGE_SIZE];
+  for (uint32_t i = 1; i < kPageCount; ++i) {
+    ASSERT_TRUE(bf.LoadPage(pids[i], buf));
+    ASSERT_EQ(buf[0], (char)(i + 1));
+    ASSERT_EQ(buf[PAGE_SIZE - 1], (char)(i + 1));
+  }
+
+  // Evictions now find clean victims
+  yase::Page *p = bm->PinPage(bf.CreatePage());
+  ASSERT_NE(p, nullptr);
+  ASSERT_EQ(bm->victim_flush_count, 0);
+
+  bm->UnpinPage(p);
+  bm->UnpinPage(pinned);
+  bm->UnregisterFile(&bf);
+  int ret = system("rm -rf test_reg");
+  LOG_IF(FATAL, ret == -1) << "Error cleaning up testing files";
+}
+
+// Concurrent misses on the same page share one read and one frame
+TEST_F(BufferManagerTests, ConcurrentMissSamePage) {
+  static const uint32_t kThreads = 8;
+
+  yase::BaseFile bf("test_reg");
+  NewBufferManager();
+  bm->RegisterFile(&bf);
+
+  for (uint32_t round = 0; round < 100; ++round) {
+    yase::PageId pid = bf.CreatePage();
+    yase::Page *pages[kThreads];
+    std::vector<std::thread> threads;
+    for (uint32_t t = 0; t < kThreads; ++t) {
+      threads.emplace_back([&, t]() { pages[t] = bm->PinPage(pid); });
+    }
+    for (auto &t : threads) {
+      t.join();
+    }
+    for (uint32_t t = 0; t < kThreads; ++t) {
+      ASSERT_EQ(pages[t], pages[0]);
+      ASSERT_EQ(pages[t]->io_state, yase::Page::kIoDone);
+    }
+    ASSERT_EQ(pages[0]->pin_count, kThreads);
+    for (uint32_t t = 0; t < kThreads; ++t) {
+      bm->UnpinPage(pages[t]);
+    }
+  }
+
+  // A failed read puts the frame it evicted a page for on the free list
+  ASSERT_EQ(bm->size_classes[0].free_frames.size(), 0);
+  ASSERT_EQ(bm->PinPage(yase::PageId(bf.GetId(), bf.GetPageCount())), nullptr);
+  ASSERT_EQ(bm->size_classes[0].free_frames.size(), 1);
+
+  int ret = system("rm -rf test_reg");
+  LOG_IF(FATAL, ret == -1) << "Error cleaning up testing files";
+}
+
+// Microbenchmark: throughput of concurrent PinPage misses on different pages
+TEST_F(BufferManagerTests, ConcurrentMissThroughput) {
+  static const uint32_t kFilePages = kPageCount * 8;
+  static const uint32_t kPinsPerThread = 5000;
+
+  yase::BaseFile bf("test_reg");
+  NewBufferManager();
+  bm->RegisterFile(&bf);
+
+  std::vector<yase::PageId> pids;
+  for (uint32_t i = 0; i < kFilePages; ++i) {
+    pids.push_back(bf.CreatePage());
+  }
+
+  for (uint32_t nthreads = 1; nthreads <= 4; nthreads *= 2) {
+    std::vector<std::thread> threads;
+    uint64_t misses = bm->miss_count;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t t = 0; t < nthreads; ++t) {
+      threads.emplace_back([&, t]() {
+        std::mt19937 rng(t);
+        for (uint32_t i = 0; i < kPinsPerThread; ++i) {
+          yase::Page *p = bm->PinPage(pids[rng() % kFilePages]);
+          ASSERT_NE(p, nullptr);
+          bm->UnpinPage(p);
+        }
+      });
+    }
+    for (auto &t : threads) {
+      t.join();
+    }
+    auto end = std::chrono::steady_clock::now();
+    double secs = std::chrono::duration<double>(end - start).count();
+    std::cout << "PinPage misses, " << nthreads << " threads: "
+              << (bm->miss_count - misses) / secs << " misses/s" << std::endl;
+  }
+
+  int ret = system("rm -rf test_reg");
+  LOG_IF(FATAL, ret == -1) << "Error cleaning up testing files";
+}
+
+// Microbenchmark: throughput of PinPage when every pin is a buffer miss
+TEST_F(BufferManagerTests, PinMissThroughput) {
+  static const uint32_t kFilePages = kPageCount * 4;
+  static const uint32_t kPins = 20000;
+
+  yase::BaseFile bf("test_reg");
+  NewBufferManager();
+  bm->RegisterFile(&bf);
+
+  std::vector<yase::PageId> pids;
+  for (uint32_t i = 0; i < kFilePages; ++i) {
+    pids.push_back(bf.CreatePage());
+  }
+
+  // Cycling through more pages than there are frames makes every pin a miss;
+  // a stride keeps read-ahead out of it
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < kPins; ++i) {
+    yase::Page *p = bm->PinPage(pids[i * 7 % kFilePages]);
+    ASSERT_NE(p, nullptr);
+    bm->UnpinPage(p);
+  }
+  auto end = std::chrono::steady_clock::now();
+  double secs = std::chrono::duration<double>(end - start).count();
+  std::cout << "PinPage misses: " << kPins / secs << " pins/s" << std::endl;
+
+  int ret = system("rm -rf test_reg");
+  LOG_IF(FATAL, ret == -1) << "Error cleaning up testing files";
+}
+
+// Prefetched pages are read in the background and pinned without a miss
+TEST_F(BufferManagerTests, Prefetch) {
+  yase::BaseFile bf("test_reg");
+  NewBufferManager();
+  bm->RegisterFile(&bf);
+
+  std::vector<yase::PageId> pids;
+  for (uint32_t i = 0; i < kPageCount / 2; ++i) {
+    pids.push_back(bf.CreatePage());
+  }
+
+  // The range is cut off at the end of the file
+  ASSERT_EQ(bm->Prefetch(pids[0], kPageCount), kPageCount / 2);
+  ASSERT_EQ(bm->size_classes[0].free_frames.size(), kPageCount - kPageCount / 2);
+
+  // Already buffered pages are skipped
+  ASSERT_EQ(bm->Prefetch(pids[0], kPageCount), 0);
+
+  for (auto &pid : pids) {
+    yase::Page *p = bm->PinPage(pid);
+    ASSERT_NE(p, nullptr);
+    ASSERT_EQ(p->io_state, yase::Page::kIoDone);
+    bm->UnpinPage(p);
+  }
+  ASSERT_EQ(bm->miss_count, 0);
+
+  // Unregistering waits for the prefetcher
+  bm->Prefetch(pids[0], kPageCount);
+  bm->UnregisterFile(&bf);
+  ASSERT_EQ(bm->size_classes[0].free_frames.size(), kPageCount);
+
+  // Nothing is prefetched into frames that are all pinned
+  bm->RegisterFile(&bf);
+  std::vector<yase::Page *> pinned;
+  for (uint32_t i = 0; i < kPageCount; ++i) {
+    pinned.push_back(bm->PinPage(bf.CreatePage()));
+    ASSERT_NE(pinned.back(), nullptr);
+  }
+  ASSERT_EQ(bm->Prefetch(pids[0], kPageCount / 2), 0);
+  for (auto p : pinned) {
+    bm->UnpinPage(p);
+  }
+
+  int ret = system("rm -rf test_reg");
+  LOG_IF(FATAL, ret == -1) << "Error cleaning up testing files";
+}
+
+// Sequential misses start read-ahead, which then keeps ahead of the reader
+TEST_F(BufferManagerTests, SequentialReadAhead) {
+  static const uint32_t kFilePages = kPageCount * 3;
+
+  yase::BaseFile bf("test_reg");
+  NewBufferManager();
+  bm->RegisterFile(&bf);
+
+  std::vector<yase::PageId> pids;
+  for (uint32_t i = 0; i < kFilePages; ++i) {
+    pids.push_back(bf.CreatePage());
+  }
+
+  for (auto &pid : pids) {
+    yase::Page *p = bm->PinPage(pid);
+    ASSERT_NE(p, nullptr);
+    bm->UnpinPage(p);
+  }
+  std::cout << "Sequential scan of " << kFilePages << " pages: "
+            << bm->miss_count << " misses" << std::endl;
+  ASSERT_LE(bm->miss_count, kFilePages / 4);
+
+  // Without read-ahead every page is a miss
+  bm->UnregisterFile(&bf);
+  bm->RegisterFile(&bf);
+  bm->SetReadAheadPages(0);
+  bm->miss_count = 0;
+  for (auto &pid : pids) {
+    yase::Page *p = bm->PinPage(pid);
+    ASSERT_NE(p, nullptr);
+    bm->UnpinPage(p);
+  }
+  ASSERT_EQ(bm->miss_count, kFilePages);
+
+  int ret = system("rm -rf test_reg");
+  LOG_IF(FATAL, ret == -1) << "Error cleaning up testing files";
+}
+
+// A read-ahead trigger evicted before anyone hit it does not carry over to
+// the next page loaded into its frame
+TEST_F(BufferManagerTests, EvictedReadAheadTrigger) {
+  yase::BaseFile bf("test_reg");
+  NewBufferManager();
+  bm->RegisterFile(&bf);
+
+  std::vector<yase::PageId> pids;
+  for (uint32_t i = 0; i < kPageCount * 3; ++i) {
+    pids.push_back(bf.CreatePage());
+  }
+
+  // Two sequential misses prefetch a window, its first page the trigger
+  for (uint32_t i = 0; i < 2; ++i) {
+    yase::Page *p = bm->PinPage(pids[i]);
+    ASSERT_NE(p, nullptr);
+    bm->UnpinPage(p);
+  }
+  bm->DrainPrefetches();
+  ASSERT_TRUE(bm->EvictPage(pids[2]));
+
+  // The freed frame is reused first; hitting the page there reads nothing
+  yase::PageId pid = pids[kPageCount * 2];
+  for (uint32_t i = 0; i < 2; ++i) {
+    yase::Page *p = bm->PinPage(pid);
+    ASSERT_NE(p, nullptr);
+    ASSERT_FALSE(p->readahead_trigger);
+    bm->UnpinPage(p);
+  }
+  bm->DrainPrefetches();
+  for (uint32_t i = 0; i < kPageCount; ++i) {
+    ASSERT_NE(bm->page_frames[i].GetPageId().value, pids[kPageCount * 2 + 1].value);
+  }
+  bm->UnregisterFile(&bf);
+
+  int ret = system("rm -rf test_reg");
+  LOG_IF(FATAL, ret == -1) << "Error cleaning up testing files";
+}
+
+// A checkpoint writes back every dirty page, pinned or not
+TEST_F(BufferManagerTests, Checkpoint) {
+  NewBufferManager();
+  bm->SetDirtyWatermarks(1, 1);
+  yase::BaseFile bf("test_reg");
+  bm->RegisterFile(&bf);
+
+  std::vector<yase::PageId> pids;
+  yase::Page *pinned = nullptr;
+  for (uint32_t i = 0; i < kPageCount; ++i) {
+    pids.push_back(bf.CreatePage());
+    yase::Page *p = bm->PinPage(pids.back());
+    ASSERT_NE(p, nullptr);
+    memset(p->page_data, 'a' + i, PAGE_SIZE);
+    p->SetDirty(true);
+    if (i == 0) {
+      pinned = p;
+    } else {
+      bm->UnpinPage(p);
+    }
+  }
+
+  ASSERT_TRUE(bm->Checkpoint());
+  char buf[PAGE_SIZE];
+  for (uint32_t i = 0; i < kPageCount; ++i) {
+    ASSERT_FALSE(bm->page_frames[i].IsDirty());
+    ASSERT_TRUE(bf.LoadPage(pids[i], buf));
+    ASSERT_EQ(buf[0], 'a' + i);
+  }
+  ASSERT_EQ(pinned->GetPinCount(), 1);
+  bm->UnpinPage(pinned);
+  bm->UnregisterFile(&bf);
+
+  int ret = system("rm -rf test_reg");
+  LOG_IF(FATAL, ret == -1) << "Error cleaning up testing files";
+}
+
+// Pages of a file opened with direct I/O go through the buffer pool frames
+TEST_F(BufferManagerTests, DirectIO) {
+  NewBufferManager();
+  yase::BaseFile bf("test_reg", true);
+  bm->RegisterFile(&bf);
+
+  std::vector<yase::PageId> pids;
+  for (uint32_t i = 0; i < kPageCount * 2; ++i) {
+    pids.push_back(bf.CreatePage());
+    yase::Page *p = bm->PinPage(pids.back());
+    ASSERT_NE(p, nullptr);
+    memset(p->page_data, 'a' + i, PAGE_SIZE);
+    p->SetDirty(true);
+    bm->UnpinPage(p);
+  }
+
+  // The first half was evicted and is read back from storage
+  for (uint32_t i = 0; i < kPageCount * 2; ++i) {
+    yase::Page *p = bm->PinPage(pids[i]);
+    ASSERT_NE(p, nullptr);
+    ASSERT_EQ(p->page_data[0], 'a' + i);
+    ASSERT_EQ(p->page_data[PAGE_SIZE - 1], 'a' + i);
+    bm->UnpinPage(p);
+  }
+  bm->UnregisterFile(&bf);
+
+  int ret = system("rm -rf test_reg");
+  LOG_IF(FATAL, ret == -1) << "Error cleaning up testing files";
+}
+
+// Files with different page sizes get frames of their own size class, and
+// evictions stay within the class
+TEST_F(BufferManagerTests, SizeClasses) {
+  static const uint32_t kLargePageSize = 65536;
+  yase::BufferManager::Initialize({{PAGE_SIZE, kPageCount}, {kLargePageSize, kPageCount / 2}});
+  bm = yase::BufferManager::Get();
+  ASSERT_EQ(bm->page_count, kPageCount + kPageCount / 2);
+  ASSERT_EQ(bm->size_classes.size(), 2);
+  ASSERT_EQ(bm->size_classes[1].first_frame, kPageCount);
+  for (uint32_t i = kPageCount; i < bm->page_count; ++i) {
+    ASSERT_EQ(bm->page_frames[i].size_class, 1);
+    ASSERT_EQ((uintptr_t)bm->page_frames[i].page_data % kLargePageSize, 0);
+  }
+
+  yase::BaseFile small("test_reg");
+  yase::BaseFile large("test_reg_large", false, kLargePageSize);
+  ASSERT_EQ(large.GetPageSize(), kLargePageSize);
+  bm->RegisterFile(&small);
+  bm->RegisterFile(&large);
+
+  // Fill the small class and keep it pinned
+  std::vector<yase::Page *> pinned;
+  for (uint32_t i = 0; i < kPageCount; ++i) {
+    yase::Page *p = bm->PinPage(small.CreatePage());
+    ASSERT_NE(p, nullptr);
+    pinned.push_back(p);
+  }
+
+  // Large pages still find frames, and are written back whole on eviction
+  std::vector<yase::PageId> pids;
+  for (uint32_t i = 0; i < kPageCount; ++i) {
+    pids.push_back(large.CreatePage());
+    yase::Page *p = bm->PinPage(pids.back());
+    ASSERT_NE(p, nullptr);
+    ASSERT_EQ(p->size_class, 1);
+    memset(p->page_data, 'a' + i, kLargePageSize);
+    p->SetDirty(true);
+    bm->UnpinPage(p);
+  }
+  for (uint32_t i = 0; i < kPageCount; ++i) {
+    yase::Page *p = bm->PinPage(pids[i]);
+    ASSERT_NE(p, nullptr);
+    ASSERT_EQ(p->page_data[0], 'a' + i);
+    ASSERT_EQ(p->page_data[kLargePageSize - 1], 'a' + i);
+    bm->UnpinPage(p);
+  }
+
+  for (auto p : pinned) {
+    bm->UnpinPage(p);
+  }
+  bm->UnregisterFile(&small);
+  bm->UnregisterFile(&large);
+  ASSERT_EQ(bm->size_classes[0].free_frames.size(), kPageCount);
+  ASSERT_EQ(bm->size_classes[1].free_frames.size(), kPageCount / 2);
+
+  int ret = system("rm -rf test_reg test_reg_large");
+  LOG_IF(FATAL, ret == -1) << "Error cleaning up testing files";
+}
+
+// Microbenchmark: throughput of concurrent PinPage/UnpinPage buffer hits
+TEST_F(BufferManagerTests, PinHitThroughput) {
+  static const uint32_t kPinsPerThread = 200000;
+
+  yase::BaseFile bf("test_reg");
+  NewBufferManager();
+  bm->RegisterFile(&bf);
+
+  // All pages fit in the buffer pool, so after warm-up every pin is a hit
+  std::vector<yase::PageId> pids;
+  for (uint32_t i = 0; i < kPageCount; ++i) {
+    pids.push_back(bf.CreatePage());
+    bm->UnpinPage(bm->PinPage(pids.back()));
+  }
+
+  for (uint32_t nthreads = 1; nthreads <= 8; nthreads *= 2) {
+    std::vector<std::thread> threads;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t t = 0; t < nthreads; ++t) {
+      threads.emplace_back([&, t]() {
+        for (uint32_t i = 0; i < kPinsPerThread; ++i) {
+          yase::Page *p = bm->PinPage(pids[(i + t) % kPageCount]);
+          ASSERT_NE(p, nullptr);
+          bm->UnpinPage(p);
+        }
+      });
+    }
+    for (auto &t : threads) {
+      t.join();
+    }
+    auto end = std::chrono::steady_clock::now();
+    double secs = std::chrono::duration<double>(end - start).count();
+    std::cout << "PinPage hits, " << nthreads << " threads: "
+              << nthreads * kPinsPerThread / secs << " pins/s" << std::endl;
+  }
+
+  // Nothing stays pinned
+  for (uint32_t i = 0; i < kPageCount; ++i) {
+    ASSERT_EQ(bm->page_frames[i].pin_count, 0);
+  }
+
+  int ret = system("rm -rf test_reg");
+  LOG_IF(FATAL, ret == -1) << "Error cleaning up testing files";
+}
+
+// Benchmark: hit ratio of each replacement policy for skewed point lookups
+// (80% of them to a small hot set) mixed with full scans of a table larger
+// than the pool
+TEST_F(BufferManagerTests, ScanResistance) {
+  static const uint32_t kHotPages = kPageCount / 2;
+  static const uint32_t kColdPages = kPageCount * 2;
+  static const uint32_t kScanPages = kPageCount * 3;
+  static const uint32_t kRounds = 50;
+  static const uint32_t kLookupsPerRound = 100;
+
+  yase::BaseFile bf("test_reg");
+  std::vector<yase::PageId> pids;
+  for (uint32_t i = 0; i < kHotPages + kColdPages + kScanPages; ++i) {
+    pids.push_back(bf.CreatePage());
+  }
+
+  yase::Replacer::Policy policies[] = {
+    yase::Replacer::LRU, yase::Replacer::Clock, yase::Replacer::LRUK,
+    yase::Replacer::TwoQ, yase::Replacer::ARC};
+  const char *names[] = {"LRU", "CLOCK", "LRU-K", "2Q", "ARC"};
+  double hit_ratio[5];
+
+  for (uint32_t i = 0; i < 5; ++i) {
+    yase::BufferManager::Initialize(kPageCount, policies[i]);
+    bm = yase::BufferManager::Get();
+    bm->RegisterFile(&bf);
+    bm->SetReadAheadPages(0);
+
+    std::mt19937 rng(454);
+    uint64_t pins = 0;
+    for (uint32_t r = 0; r < kRounds; ++r) {
+      for (uint32_t l = 0; l < kLookupsPerRound; ++l, ++pins) {
+        uint32_t idx = rng() % 5 ? rng() % kHotPages : kHotPages + rng() % kColdPages;
+        yase::Page *p = bm->PinPage(pids[idx]);
+        ASSERT_NE(p, nullptr);
+        bm->UnpinPage(p);
+      }
+      for (uint32_t s = 0; s < kScanPages; ++s, ++pins) {
+        yase::Page *p = bm->PinPage(pids[kHotPages + kColdPages + s]);
+        ASSERT_NE(p, nullptr);
+        bm->UnpinPage(p);
+      }
+    }
+    hit_ratio[i] = 1.0 - (double)bm->miss_count / pins;
+    std::cout << names[i] << " hit ratio: " << hit_ratio[i] << std::endl;
+    yase::BufferManager::Uninitialize();
+  }
+
+  // The scan-resistant policies keep the hot set buffered through the scans
+  ASSERT_GT(hit_ratio[2], hit_ratio[0]);
+  ASSERT_GT(hit_ratio[3], hit_ratio[0]);
+  ASSERT_GT(hit_ratio[4], hit_ratio[0]);
+
+  int ret = system("rm -rf test_reg");
+  LOG_IF(FATAL, ret == -1) << "Error cleaning up testing files";
+}
+
 }  // namespace yase
 
 int main(int argc, char **argv) {
@@ -0,0 +1,194 @@
+/*
+ * YASE: Yet Another Storage Engine
+ *
+ * CMPT 454 Database Systems II, Spring 2025
+ *
+ * Copyright (C) School of Computing Science, Simon Fraser University
+ *
+ * Not for distribution without prior approval.
+ *
+ * Test cases for the catalog.
+ */
+
+#include <chrono>
+#include <iostream>
+#include <string>
+
+#include <unistd.h>
+
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+#include <Storage/buffer_manager.h>
+#include <Storage/catalog.h>
+#include <Log/log_manager.h>
+
+namespace yase {
+
+static const uint32_t kPageCount = 20;
+
+class CatalogTests : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    BufferManager::Initialize({{PAGE_SIZE, kPageCount}, {16384, 4}});
+  }
+  void TearDown() override {
+    BufferManager::Uninitialize();
+    int ret = system("rm -rf test_catalog cat_table* cat_index_nodes*");
+    LOG_IF(FATAL, ret == -1) << "Error cleaning up testing files";
+  }
+
+  // Close the catalog and its tables, and start over with an empty buffer
+  // pool as after a restart
+  void Restart(Catalog *&catalog) {
+    delete catalog;
+    BufferManager::Uninitialize();
+    BufferManager::Initialize({{PAGE_SIZE, kPageCount}, {16384, 4}});
+    catalog = new Catalog("test_catalog", true);
+  }
+};
+
+// Tables created through the catalog keep their metadata across restarts
+TEST_F(CatalogTests, Tables) {
+  Catalog *catalog = new Catalog("test_catalog");
+  Table *t1 = catalog->CreateTable("cat_table1", 8);
+  Table *t2 = catalog->CreateTable("cat_table2", 100, false, 16384);
+  ASSERT_NE(t1, nullptr);
+  ASSERT_NE(t2, nullptr);
+  ASSERT_EQ(catalog->CreateTable("cat_table1", 8), nullptr);
+  ASSERT_EQ(catalog->CreateTable(std::string(Catalog::kMaxNameLength + 1, 'x'), 8), nullptr);
+  ASSERT_EQ(catalog->GetTable("cat_table1"), t1);
+  ASSERT_EQ(catalog->GetTable("missing"), nullptr);
+
+  uint64_t v = 454;
+  RID rid1 = t1->Insert((char *)&v);
+  char record[100];
+  memset(record, 'y', sizeof(record));
+  RID rid2 = t2->Insert(record);
+  ASSERT_TRUE(rid1.IsValid());
+  ASSERT_TRUE(rid2.IsValid());
+
+  Restart(catalog);
+
+  // Nothing is opened until used
+  ASSERT_TRUE(catalog->tables.empty());
+  t2 = catalog->GetTable("cat_table2");
+  ASSERT_NE(t2, nullptr);
+  ASSERT_EQ(catalog->tables.size(), 1);
+  ASSERT_EQ(t2->record_size, 100);
+  ASSERT_EQ(t2->file.GetPageSize(), 16384);
+  memset(record, 0, sizeof(record));
+  ASSERT_TRUE(t2->Read(RID(PageId(t2->GetFileId(), rid2.GetPageNum()), rid2.GetSlotId()), record));
+  ASSERT_EQ(record[99], 'y');
+
+  t1 = catalog->GetTable("cat_table1");
+  ASSERT_NE(t1, nullptr);
+  v = 0;
+  ASSERT_TRUE(t1->Read(RID(PageId(t1->GetFileId(), rid1.GetPageNum()), rid1.GetSlotId()), &v));
+  ASSERT_EQ(v, 454);
+  delete catalog;
+}
+
+// Index metadata and roots survive restarts; roots follow their table's file
+TEST_F(CatalogTests, Indexes) {
+  Catalog *catalog = new Catalog("test_catalog");
+  Table *nodes = catalog->CreateTable("cat_index_nodes", 64);
+  ASSERT_NE(nodes, nullptr);
+  ASSERT_FALSE(catalog->CreateIndex("cat_index", "missing", 8, 8));
+  ASSERT_TRUE(catalog->CreateIndex("cat_index", "cat_index_nodes", 8, 8));
+  ASSERT_FALSE(catalog->CreateIndex("cat_index", "cat_index_nodes", 8, 8));
+  ASSERT_FALSE(catalog->GetTable("cat_index"));
+
+  Catalog::IndexInfo info;
+  ASSERT_TRUE(catalog->GetIndex("cat_index", &info));
+  ASSERT_FALSE(info.root.IsValid());
+
+  char node[64] = {0};
+  RID root = nodes->Insert(node);
+  ASSERT_TRUE(catalog->SetIndexRoot("cat_index", root));
+  ASSERT_FALSE(catalog->SetIndexRoot("cat_index_nodes", root));
+
+  Restart(catalog);
+  ASSERT_FALSE(catalog->GetIndex("cat_index_nodes", &info));
+  ASSERT_TRUE(catalog->GetIndex("cat_index", &info));
+  ASSERT_EQ(info.table, "cat_index_nodes");
+  ASSERT_EQ(info.key_size, 8);
+  ASSERT_EQ(info.payload_size, 8);
+  ASSERT_EQ(info.root.GetFileId(), catalog->GetTable("cat_index_nodes")->GetFileId());
+  ASSERT_EQ(info.root.GetPageNum(), root.GetPageNum());
+  ASSERT_EQ(info.root.GetSlotId(), root.GetSlotId());
+  delete catalog;
+}
+
+// More entries than fit a catalog page
+TEST_F(CatalogTests, ManyEntries) {
+  static const uint32_t kIndexes = 3 * PAGE_SIZE / sizeof(Catalog::Entry);
+  Catalog *catalog = new Catalog("test_catalog");
+  ASSERT_NE(catalog->CreateTable("cat_table", 8), nullptr);
+  for (uint32_t i = 0; i < kIndexes; ++i) {
+    ASSERT_TRUE(catalog->CreateIndex("cat_index" + std::to_string(i), "cat_table", i, i));
+  }
+  ASSERT_EQ(catalog->file.GetPageCount(), 4);
+
+  Restart(catalog);
+  for (uint32_t i = 0; i < kIndexes; ++i) {
+    Catalog::IndexInfo info;
+    ASSERT_TRUE(catalog->GetIndex("cat_index" + std::to_string(i), &info));
+    ASSERT_EQ(info.key_size, i);
+  }
+  delete catalog;
+}
+
+// A table the catalog has no room for leaves no files behind
+TEST_F(CatalogTests, CatalogFull) {
+  Catalog *catalog = new Catalog("test_catalog");
+
+  // With every frame pinned, no catalog page can be read or added
+  BaseFile bf("cat_table_pins");
+  BufferManager::Get()->RegisterFile(&bf);
+  std::vector<Page *> pinned;
+  for (uint32_t i = 0; i < kPageCount; ++i) {
+    pinned.push_back(BufferManager::Get()->PinPage(bf.CreatePage()));
+    ASSERT_NE(pinned.back(), nullptr);
+  }
+  ASSERT_EQ(catalog->CreateTable("cat_table_full", 8), nullptr);
+  ASSERT_NE(access("cat_table_full", F_OK), 0);
+  ASSERT_NE(access("cat_table_full.dir", F_OK), 0);
+  for (auto p : pinned) {
+    BufferManager::Get()->UnpinPage(p);
+  }
+  BufferManager::Get()->UnregisterFile(&bf);
+
+  ASSERT_NE(catalog->CreateTable("cat_table_full", 8), nullptr);
+  delete catalog;
+}
+
+// Benchmark: restart with many tables, opening one of them
+TEST_F(CatalogTests, LazyOpen) {
+  static const uint32_t kTables = 64;
+  Catalog *catalog = new Catalog("test_catalog");
+  for (uint32_t i = 0; i < kTables; ++i) {
+    ASSERT_NE(catalog->CreateTable("cat_table" + std::to_string(i), 8), nullptr);
+  }
+  delete catalog;
+  BufferManager::Uninitialize();
+  BufferManager::Initialize({{PAGE_SIZE, kPageCount}, {16384, 4}});
+
+  auto start = std::chrono::steady_clock::now();
+  catalog = new Catalog("test_catalog", true);
+  ASSERT_NE(catalog->GetTable("cat_table" + std::to_string(kTables - 1)), nullptr);
+  double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  std::cout << "Restart with " << kTables << " tables, open one: " << secs * 1000 << " ms"
+            << std::endl;
+  ASSERT_EQ(catalog->tables.size(), 1);
+  delete catalog;
+}
+
+}  // namespace yase
+
+int main(int argc, char **argv) {
+  yase::LogManager::Initialize("log_file", 1);
+  ::google::InitGoogleLogging(argv[0]);
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
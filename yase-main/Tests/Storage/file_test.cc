@@ -10,7 +10,10 @@
  * Test cases for File abstraction.
  */
 
+#include <chrono>
+#include <iostream>
 #include <thread>
+#include <sys/stat.h>
 #include <glog/logging.h>
 #include <gtest/gtest.h>
 #include <gflags/gflags.h>
@@ -95,11 +98,12 @@ TEST_F(FileTests, AllocatePage) {
   ASSERT_EQ(file->GetDir()->GetPageCount(), 1);
 
   // Check page parameters
-  auto page_space = std::unique_ptr<char[]>(new char[sizeof(yase::Page)]);
-  yase::Page *page = (yase::Page *)page_space.get();
-  LoadDataPage(pid, page);
-  ASSERT_EQ(page->GetDataPage()->GetRecordCount(), 0);
-  ASSERT_EQ(page->GetDataPage()->GetRecordSize(), kRecordSize);
+  auto page_space = std::unique_ptr<char[]>(new char[PAGE_SIZE]);
+  yase::Page page;
+  page.page_data = page_space.get();
+  LoadDataPage(pid, &page);
+  ASSERT_EQ(page.GetDataPage()->GetRecordCount(), 0);
+  ASSERT_EQ(page.GetDataPage()->GetRecordSize(), kRecordSize);
 }
 
 // Deallocate a non-existant data page
@@ -185,8 +189,221 @@ TEST_F(FileTests, ScavengeAlloc) {
   ASSERT_EQ(apid.value, pid.value);
 }
 
+// Deallocated pages are scavenged lowest first, also after reopening the
+// file (when the free pages are found from the directory)
+TEST_F(FileTests, ScavengeOrder) {
+  static const uint32_t kEntriesPerDirPage = yase::DirectoryPage::kEntries;
+  static const uint32_t kPages = kEntriesPerDirPage + 200;
+  uint32_t freed[] = {kEntriesPerDirPage + 100, 3, 70, kEntriesPerDirPage + 1};
+  uint32_t sorted[] = {3, 70, kEntriesPerDirPage + 1, kEntriesPerDirPage + 100};
+
+  NewFile();
+  for (uint32_t i = 0; i < kPages; ++i) {
+    ASSERT_TRUE(file->AllocatePage().IsValid());
+  }
+  for (uint32_t page_num : freed) {
+    ASSERT_TRUE(file->DeallocatePage(yase::PageId(file->GetId(), page_num)));
+  }
+  for (uint32_t page_num : sorted) {
+    ASSERT_EQ(file->ScavengePage().GetPageNum(), page_num);
+  }
+  ASSERT_FALSE(file->ScavengePage().IsValid());
+
+  for (uint32_t page_num : freed) {
+    ASSERT_TRUE(file->DeallocatePage(yase::PageId(file->GetId(), page_num)));
+  }
+  delete file;
+  file = new yase::File(file_name.c_str(), kRecordSize, false, PAGE_SIZE, true);
+  ASSERT_FALSE(file->free_pages_loaded);
+  for (uint32_t page_num : sorted) {
+    ASSERT_EQ(file->AllocatePage().GetPageNum(), page_num);
+  }
+  ASSERT_TRUE(file->free_pages_loaded);
+  ASSERT_EQ(file->AllocatePage().GetPageNum(), kPages);
+}
+
+// Benchmark: allocating pages in a growing file no longer gets slower with
+// the number of directory pages
+TEST_F(FileTests, AllocateThroughput) {
+  static const uint32_t kPages = 32768;
+  NewFile();
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < kPages; ++i) {
+    ASSERT_TRUE(file->AllocatePage().IsValid());
+  }
+  double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  std::cout << "AllocatePage: " << kPages / secs << " pages/s" << std::endl;
+}
+
+// Runs of pages allocated at once are consecutive and may span directory
+// pages; benchmark against allocating them one by one
+TEST_F(FileTests, AllocatePages) {
+  static const uint32_t kEntriesPerDirPage = yase::DirectoryPage::kEntries;
+  static const uint32_t kPages = 32768;
+  NewFile();
+  ASSERT_FALSE(file->AllocatePages(0).IsValid());
+  ASSERT_EQ(file->AllocatePage().GetPageNum(), 0);
+  ASSERT_EQ(file->FindPageWithSpace().GetPageNum(), 0);
+  yase::PageId first = file->AllocatePages(kEntriesPerDirPage + 10);
+  ASSERT_EQ(first.GetPageNum(), 1);
+  ASSERT_EQ(file->GetPageCount(), kEntriesPerDirPage + 11);
+  ASSERT_EQ(file->GetDir()->GetPageCount(), 2);
+  ASSERT_TRUE(file->PageExists(yase::PageId(file->GetId(), kEntriesPerDirPage + 10)));
+  ASSERT_FALSE(file->PageExists(yase::PageId(file->GetId(), kEntriesPerDirPage + 11)));
+  ASSERT_EQ(file->free_space.Get(kEntriesPerDirPage + 10), file->page_capacity);
+
+  // Deallocated pages of a run are scavenged like any other
+  ASSERT_TRUE(file->DeallocatePage(yase::PageId(file->GetId(), 100)));
+  ASSERT_EQ(file->AllocatePage().GetPageNum(), 100);
+
+  auto start = std::chrono::steady_clock::now();
+  ASSERT_TRUE(file->AllocatePages(kPages).IsValid());
+  double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  std::cout << "AllocatePages: " << kPages / secs << " pages/s" << std::endl;
+}
+
+// Space of deallocated pages is returned: holes in the middle, truncation at
+// the end
+TEST_F(FileTests, ReclaimSpace) {
+  static const uint32_t kPages = 40;
+  NewFile();
+  for (uint32_t i = 0; i < kPages; ++i) {
+    ASSERT_TRUE(file->AllocatePage().IsValid());
+  }
+  for (uint32_t i = 5; i < 15; ++i) {
+    ASSERT_TRUE(file->DeallocatePage(yase::PageId(file->GetId(), i)));
+  }
+  for (uint32_t i = 30; i < kPages; ++i) {
+    ASSERT_TRUE(file->DeallocatePage(yase::PageId(file->GetId(), i)));
+  }
+
+  // Holes need file system support; truncation always works. Write-backs
+  // by the page cleaner are waited for, so no page is skipped for them.
+  ASSERT_TRUE(yase::BufferManager::Get()->Checkpoint());
+  uint32_t skipped = 0;
+  uint32_t reclaimed = file->ReclaimSpace(&skipped);
+  ASSERT_GE(reclaimed, 10);
+  ASSERT_EQ(reclaimed + skipped, 20);
+  ASSERT_EQ(file->GetPageCount(), 30);
+  struct stat st;
+  ASSERT_EQ(fstat(file->GetFd(), &st), 0);
+  ASSERT_EQ(st.st_size, 30 * PAGE_SIZE);
+  ASSERT_EQ(file->ReclaimSpace(), 0);
+  ASSERT_FALSE(file->PageExists(yase::PageId(file->GetId(), 5)));
+
+  // Scavenged holes come back as empty pages; truncated ones as new pages
+  for (uint32_t i = 5; i < 15; ++i) {
+    yase::PageId pid = file->AllocatePage();
+    ASSERT_EQ(pid.GetPageNum(), i);
+    yase::Page *p = yase::BufferManager::Get()->PinPage(pid);
+    ASSERT_NE(p, nullptr);
+    ASSERT_EQ(p->GetDataPage()->GetRecordSize(), kRecordSize);
+    ASSERT_EQ(p->GetDataPage()->GetRecordCount(), 0);
+    yase::BufferManager::Get()->UnpinPage(p);
+  }
+  ASSERT_EQ(file->AllocatePage().GetPageNum(), 30);
+  ASSERT_EQ(file->ReclaimSpace(), 0);
+}
+
+// The free-space map finds the first page with enough free slots
+TEST(FreeSpaceMapTests, Find) {
+  yase::FreeSpaceMap fsm;
+  ASSERT_EQ(fsm.Find(1), yase::FreeSpaceMap::kInvalidPage);
+  fsm.Set(1000, 0);
+  ASSERT_EQ(fsm.leaves, 0);
+
+  fsm.Set(5, 3);
+  fsm.Set(70, 10);
+  fsm.Set(1000, 7);
+  ASSERT_EQ(fsm.leaves, 1024);
+  ASSERT_EQ(fsm.Get(70), 10);
+  ASSERT_EQ(fsm.Find(1), 5);
+  ASSERT_EQ(fsm.Find(4), 70);
+  ASSERT_EQ(fsm.Find(11), yase::FreeSpaceMap::kInvalidPage);
+
+  fsm.Set(70, 0);
+  ASSERT_EQ(fsm.Find(4), 1000);
+  fsm.Set(5, 0);
+  fsm.Set(1000, 0);
+  ASSERT_EQ(fsm.Find(1), yase::FreeSpaceMap::kInvalidPage);
+  fsm.Set(2, 1);
+  ASSERT_EQ(fsm.Find(1), 2);
+}
+
+// Directories of the original format are converted to the packed one
+TEST_F(FileTests, ConvertDirectory) {
+  static const uint32_t kPages = 20;
+  static const uint32_t kLegacyEntries = PAGE_SIZE / sizeof(yase::LegacyDirectoryEntry);
+  static const uint32_t kFarPage = 8 * kLegacyEntries + 3;
+  uint16_t capacity = yase::GetDataPageCapacity(PAGE_SIZE, kRecordSize);
+
+  NewFile();
+  for (uint32_t i = 0; i < kPages; ++i) {
+    ASSERT_TRUE(file->AllocatePage().IsValid());
+  }
+  delete file;
+  file = nullptr;
+
+  // Rewrite the directory as an old version would have: page 5 deallocated,
+  // page 7 full, and an entry in the ninth directory page
+  {
+    yase::BaseFile old_dir(file_name + ".dir");
+    std::vector<yase::LegacyDirectoryEntry> entries(kLegacyEntries);
+    for (uint32_t i = 0; i < 9; ++i) {
+      memset(entries.data(), 0, PAGE_SIZE);
+      for (uint32_t j = 0; j < kLegacyEntries; ++j) {
+        uint32_t page_num = i * kLegacyEntries + j;
+        if (page_num < kPages || page_num == kFarPage) {
+          entries[j] = {capacity, page_num != 5, true};
+        }
+      }
+      if (i == 0) {
+        entries[7].free_slots = 0;
+      }
+      ASSERT_TRUE(old_dir.FlushPage(old_dir.CreatePage(), entries.data()));
+    }
+  }
+
+  ASSERT_TRUE(yase::File::ConvertDirectory(file_name, kRecordSize));
+  file = new yase::File(file_name, kRecordSize, false, PAGE_SIZE, true);
+  ASSERT_EQ(file->GetDir()->GetPageCount(), 2);
+  ASSERT_TRUE(file->PageExists(yase::PageId(file->GetId(), 4)));
+  ASSERT_FALSE(file->PageExists(yase::PageId(file->GetId(), 5)));
+  ASSERT_TRUE(file->PageExists(yase::PageId(file->GetId(), kFarPage)));
+  ASSERT_EQ(file->FindPageWithSpace().GetPageNum(), 0);
+  ASSERT_EQ(file->free_space.Get(7), 0);
+  ASSERT_EQ(file->free_space.Get(8), file->page_capacity);
+  ASSERT_EQ(file->ScavengePage().GetPageNum(), 5);
+  int ret = system(("rm -rf " + file_name + ".dir").c_str());
+  LOG_IF(FATAL, ret == -1) << "Error cleaning up testing files";
+}
+
 static const uint32_t kThreads = 5;
 // Multi-threaded test for creating files
+// Allocations spanning several directory pages land in the right entries
+TEST_F(FileTests, ManyDirectoryPages) {
+  static const uint32_t kEntriesPerDirPage = yase::DirectoryPage::kEntries;
+  static const uint32_t kPages = kEntriesPerDirPage * 2 + 5;
+
+  NewFile();
+  for (uint32_t i = 0; i < kPages; ++i) {
+    yase::PageId pid = file->AllocatePage();
+    ASSERT_TRUE(pid.IsValid());
+    ASSERT_EQ(pid.GetPageNum(), i);
+  }
+  ASSERT_EQ(file->GetDir()->GetPageCount(), 3);
+
+  // Every page is recorded in its own entry
+  for (uint32_t i = 0; i < kPages; i += 7) {
+    ASSERT_TRUE(file->PageExists(yase::PageId(file->GetId(), i)));
+  }
+  ASSERT_TRUE(file->DeallocatePage(yase::PageId(file->GetId(), kEntriesPerDirPage + 1)));
+  ASSERT_FALSE(file->PageExists(yase::PageId(file->GetId(), kEntriesPerDirPage + 1)));
+  ASSERT_TRUE(file->PageExists(yase::PageId(file->GetId(), 1)));
+  ASSERT_TRUE(file->PageExists(yase::PageId(file->GetId(), 2 * kEntriesPerDirPage + 1)));
+  ASSERT_FALSE(file->DeallocatePage(yase::PageId(file->GetId(), 3 * kEntriesPerDirPage)));
+}
+
 GTEST_TEST(File, MultiThreadCreation) {
   yase::BufferManager::Initialize(10);
   std::vector<std::thread> threads;
@@ -0,0 +1,204 @@
+/*
+ * YASE: Yet Another Storage Engine
+ *
+ * CMPT 454 Database Systems II, Spring 2025
+ *
+ * Copyright (C) School of Computing Science, Simon Fraser University
+ *
+ * Not for distribution without prior approval.
+ *
+ * Test cases for IoEngine.
+ */
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+#include <Storage/io_engine.h>
+
+namespace yase {
+
+static const uint32_t kPages = 64;
+
+class IoEngineTests : public ::testing::TestWithParam<IoEngine::Backend> {
+ protected:
+  IoEngine *engine;
+  int fd;
+  char *buffer;
+
+  void SetUp() override {
+    engine = IoEngine::Create(GetParam(), 8);
+    if (!engine) {
+      GTEST_SKIP() << "Backend not available";
+    }
+    fd = open("test_io_engine", O_CREAT | O_RDWR | O_TRUNC, S_IRUSR | S_IWUSR);
+    ASSERT_GE(fd, 0);
+    buffer = (char *)aligned_alloc(PAGE_SIZE, kPages * PAGE_SIZE);
+    ASSERT_TRUE(buffer);
+  }
+  void TearDown() override {
+    if (!engine) {
+      return;
+    }
+    delete engine;
+    close(fd);
+    free(buffer);
+    int ret = system("rm -rf test_io_engine");
+    LOG_IF(FATAL, ret == -1) << "Error cleaning up testing files";
+  }
+
+  void Prepare(IoRequest *reqs, IoRequest **ptrs, bool write) {
+    for (uint32_t i = 0; i < kPages; ++i) {
+      reqs[i].fd = fd;
+      reqs[i].write = write;
+      reqs[i].buf = buffer + i * PAGE_SIZE;
+      reqs[i].len = PAGE_SIZE;
+      reqs[i].offset = (uint64_t)i * PAGE_SIZE;
+      ptrs[i] = &reqs[i];
+    }
+  }
+};
+
+// A batch larger than the queue depth is written and read back
+TEST_P(IoEngineTests, WriteRead) {
+  ASSERT_EQ(engine->GetBackend(), GetParam());
+  IoRequest reqs[kPages];
+  IoRequest *ptrs[kPages];
+
+  for (uint32_t i = 0; i < kPages; ++i) {
+    memset(buffer + i * PAGE_SIZE, 'a' + i % 26, PAGE_SIZE);
+  }
+  Prepare(reqs, ptrs, true);
+  ASSERT_EQ(engine->SubmitAndWait(ptrs, kPages), kPages);
+
+  memset(buffer, 0, kPages * PAGE_SIZE);
+  Prepare(reqs, ptrs, false);
+  ASSERT_EQ(engine->SubmitAndWait(ptrs, kPages), kPages);
+  for (uint32_t i = 0; i < kPages; ++i) {
+    ASSERT_EQ(reqs[i].result, PAGE_SIZE);
+    ASSERT_EQ(buffer[i * PAGE_SIZE], 'a' + i % 26);
+    ASSERT_EQ(buffer[(i + 1) * PAGE_SIZE - 1], 'a' + i % 26);
+  }
+}
+
+// Transfers into registered buffers behave the same
+TEST_P(IoEngineTests, RegisteredBuffers) {
+  bool registered = engine->RegisterBuffers(buffer, kPages * PAGE_SIZE);
+  ASSERT_EQ(registered, GetParam() == IoEngine::Uring);
+  IoRequest reqs[kPages];
+  IoRequest *ptrs[kPages];
+
+  for (uint32_t i = 0; i < kPages; ++i) {
+    memset(buffer + i * PAGE_SIZE, 'z' - i % 26, PAGE_SIZE);
+  }
+  Prepare(reqs, ptrs, true);
+  ASSERT_EQ(engine->SubmitAndWait(ptrs, kPages), kPages);
+
+  memset(buffer, 0, kPages * PAGE_SIZE);
+  Prepare(reqs, ptrs, false);
+  ASSERT_EQ(engine->SubmitAndWait(ptrs, kPages), kPages);
+  for (uint32_t i = 0; i < kPages; ++i) {
+    ASSERT_EQ(buffer[i * PAGE_SIZE], 'z' - i % 26);
+  }
+}
+
+// Callbacks run once per request; errors and short reads are reported
+TEST_P(IoEngineTests, Callbacks) {
+  static std::atomic<uint32_t> done;
+  done = 0;
+  IoRequest reqs[3];
+  IoRequest *ptrs[3] = {&reqs[0], &reqs[1], &reqs[2]};
+
+  // A page, a read past the end of the (empty) file and a bad descriptor
+  for (uint32_t i = 0; i < 3; ++i) {
+    reqs[i].fd = i == 2 ? -1 : fd;
+    reqs[i].write = i == 0;
+    reqs[i].buf = buffer;
+    reqs[i].len = PAGE_SIZE;
+    reqs[i].offset = i == 1 ? 10 * PAGE_SIZE : 0;
+    reqs[i].callback = [](IoRequest *req) { ++done; };
+  }
+  engine->Submit(ptrs, 3);
+  while (done < 3) {
+    std::this_thread::yield();
+  }
+  ASSERT_TRUE(reqs[0].Succeeded());
+  ASSERT_EQ(reqs[1].result, 0);
+  ASSERT_EQ(reqs[2].result, -EBADF);
+}
+
+INSTANTIATE_TEST_SUITE_P(Backends, IoEngineTests,
+                         ::testing::Values(IoEngine::Uring, IoEngine::ThreadPool));
+
+// Benchmark: random page reads, one pread at a time vs. batches through
+// each engine
+TEST(IoEngineBenchmark, RandomReads) {
+  static const uint32_t kFilePages = 4096;
+  static const uint32_t kReads = 16384;
+  static const uint32_t kBatch = 32;
+
+  int fd = open("test_io_engine", O_CREAT | O_RDWR | O_TRUNC, S_IRUSR | S_IWUSR);
+  ASSERT_GE(fd, 0);
+  ASSERT_EQ(ftruncate(fd, (off_t)kFilePages * PAGE_SIZE), 0);
+  char *buffer = (char *)aligned_alloc(PAGE_SIZE, kBatch * PAGE_SIZE);
+
+  std::mt19937 rng(454);
+  std::vector<uint64_t> offsets;
+  for (uint32_t i = 0; i < kReads; ++i) {
+    offsets.push_back((uint64_t)(rng() % kFilePages) * PAGE_SIZE);
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < kReads; ++i) {
+    ASSERT_EQ(pread(fd, buffer, PAGE_SIZE, offsets[i]), PAGE_SIZE);
+  }
+  double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  std::cout << "pread: " << kReads / secs << " reads/s" << std::endl;
+
+  IoEngine::Backend backends[] = {IoEngine::Uring, IoEngine::ThreadPool};
+  const char *names[] = {"io_uring", "thread pool"};
+  for (uint32_t b = 0; b < 2; ++b) {
+    IoEngine *engine = IoEngine::Create(backends[b]);
+    if (!engine) {
+      continue;
+    }
+    engine->RegisterBuffers(buffer, kBatch * PAGE_SIZE);
+    IoRequest reqs[kBatch];
+    IoRequest *ptrs[kBatch];
+    start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < kReads; i += kBatch) {
+      for (uint32_t j = 0; j < kBatch; ++j) {
+        reqs[j].fd = fd;
+        reqs[j].buf = buffer + j * PAGE_SIZE;
+        reqs[j].len = PAGE_SIZE;
+        reqs[j].offset = offsets[i + j];
+        ptrs[j] = &reqs[j];
+      }
+      ASSERT_EQ(engine->SubmitAndWait(ptrs, kBatch), kBatch);
+    }
+    secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << names[b] << ", batches of " << kBatch << ": " << kReads / secs
+              << " reads/s" << std::endl;
+    delete engine;
+  }
+
+  close(fd);
+  free(buffer);
+  int ret = system("rm -rf test_io_engine");
+  LOG_IF(FATAL, ret == -1) << "Error cleaning up testing files";
+}
+
+}  // namespace yase
+
+int main(int argc, char **argv) {
+  ::google::InitGoogleLogging(argv[0]);
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,469 @@
+/*
+ * YASE: Yet Another Storage Engine
+ *
+ * CMPT 454 Database Systems II, Spring 2025
+ *
+ * Copyright (C) School of Computing Science, Simon Fraser University
+ *
+ * Not for distribution without prior approval.
+ *
+ * Test cases for data pages.
+ */
+
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+#include <Storage/page.h>
+
+namespace yase {
+
+// Reference slot search: one bit at a time
+template <typename DataPageType>
+static uint32_t FindFreeSlotSlow(DataPageType *dp, uint32_t from, uint32_t to) {
+  for (uint32_t i = from; i < to; ++i) {
+    if (!dp->SlotOccupied(i)) {
+      return i;
+    }
+  }
+  return to;
+}
+
+// Fill the slots of [dp] at random until [fill] of them are occupied
+template <typename DataPageType>
+static void FillPage(DataPageType *dp, double fill, std::mt19937 &rng) {
+  uint16_t capacity = DataPageType::GetCapacity(dp->GetRecordSize());
+  std::vector<char> record(dp->GetRecordSize(), 'p');
+  uint32_t slot;
+  while (dp->GetRecordCount() < capacity * fill) {
+    ASSERT_TRUE(dp->Insert(record.data(), slot));
+  }
+  // Punch random holes so occupied slots aren't a prefix
+  for (uint32_t i = 0; i < capacity / 4; ++i) {
+    uint32_t victim = rng() % capacity;
+    if (dp->SlotOccupied(victim)) {
+      ASSERT_TRUE(dp->Delete(RID(PageId(0, 0), victim)));
+      ASSERT_TRUE(dp->Insert(record.data(), slot));
+    }
+  }
+}
+
+// The word-level search agrees with the bit-level one, for every page size
+// and for ranges that start and end mid-word
+template <uint32_t kPageSize>
+static void CheckFindFreeSlot(uint16_t record_size) {
+  std::mt19937 rng(kPageSize + record_size);
+  auto *dp = new DataPageT<kPageSize>(record_size);
+  uint16_t capacity = DataPageT<kPageSize>::GetCapacity(record_size);
+  for (double fill : {0.0, 0.5, 0.9, 1.0}) {
+    FillPage(dp, fill, rng);
+    for (uint32_t i = 0; i < 200; ++i) {
+      uint32_t from = rng() % (capacity + 1);
+      uint32_t to = from + rng() % (capacity - from + 1);
+      ASSERT_EQ(dp->FindFreeSlot(from, to), FindFreeSlotSlow(dp, from, to));
+    }
+    ASSERT_EQ(dp->FindFreeSlot(0, capacity), FindFreeSlotSlow(dp, 0, capacity));
+  }
+  delete dp;
+}
+
+TEST(DataPageTests, FindFreeSlot) {
+  CheckFindFreeSlot<4096>(8);
+  CheckFindFreeSlot<4096>(100);
+  CheckFindFreeSlot<8192>(1);
+  CheckFindFreeSlot<16384>(24);
+  CheckFindFreeSlot<32768>(3);
+  CheckFindFreeSlot<65536>(8);
+}
+
+// Inserts take the lowest free slot; a stale hint still finds free slots
+TEST(DataPageTests, InsertHint) {
+  DataPage dp(8);
+  uint16_t capacity = DataPage::GetCapacity(8);
+  uint64_t v = 0;
+  uint32_t slot;
+  uint16_t hint = 0;
+  for (uint32_t i = 0; i < capacity; ++i) {
+    ASSERT_TRUE(dp.Insert((char *)&v, slot, &hint));
+    ASSERT_EQ(slot, i);
+    ASSERT_EQ(hint, i + 1);
+  }
+  ASSERT_FALSE(dp.Insert((char *)&v, slot, &hint));
+
+  ASSERT_TRUE(dp.Delete(RID(PageId(0, 0), 70)));
+  ASSERT_TRUE(dp.Delete(RID(PageId(0, 0), 3)));
+  hint = 100;
+  ASSERT_TRUE(dp.Insert((char *)&v, slot, &hint));
+  ASSERT_EQ(slot, 3);
+  hint = 0;
+  ASSERT_TRUE(dp.Insert((char *)&v, slot, &hint));
+  ASSERT_EQ(slot, 70);
+  ASSERT_FALSE(dp.Insert((char *)&v, slot, &hint));
+}
+
+// Slotted pages against a model of their records, with enough churn for
+// holes and compaction; every page size
+template <uint32_t kPageSize>
+static void CheckSlottedPage() {
+  std::mt19937 rng(kPageSize);
+  auto *sp = new SlottedPageT<kPageSize>();
+  std::map<uint32_t, std::string> records;
+  uint32_t compactions = 0;
+  for (uint32_t i = 0; i < 20000; ++i) {
+    uint32_t op = rng() % 10;
+    if (op < 5) {
+      std::string record(1 + rng() % (kPageSize / 16), 'a' + i % 26);
+      uint16_t free = sp->GetFreeSpace();
+      uint32_t fragmented = sp->fragmented;
+      uint32_t slot;
+      bool inserted = sp->Insert(record.data(), record.size(), slot);
+      ASSERT_EQ(inserted, record.size() <= free);
+      if (inserted) {
+        ASSERT_EQ(records.count(slot), 0);
+        records[slot] = record;
+        compactions += fragmented && !sp->fragmented;
+      }
+    } else if (op < 8 && !records.empty()) {
+      auto it = records.begin();
+      std::advance(it, rng() % records.size());
+      ASSERT_TRUE(sp->Delete(RID(PageId(0, 0), it->first)));
+      ASSERT_FALSE(sp->Delete(RID(PageId(0, 0), it->first)));
+      records.erase(it);
+    } else if (!records.empty()) {
+      auto it = records.begin();
+      std::advance(it, rng() % records.size());
+      std::string record(1 + rng() % (kPageSize / 16), 'A' + i % 26);
+      if (sp->Update(RID(PageId(0, 0), it->first), record.data(), record.size())) {
+        it->second = record;
+      }
+    }
+    ASSERT_EQ(sp->GetRecordCount(), records.size());
+  }
+  ASSERT_GT(compactions, 0);
+  for (auto &r : records) {
+    uint16_t length = 0;
+    const char *record = sp->GetRecord(RID(PageId(0, 0), r.first), &length);
+    ASSERT_NE(record, nullptr);
+    ASSERT_EQ(std::string(record, length), r.second);
+  }
+
+  // Emptied, the page takes its largest record again
+  for (auto &r : records) {
+    ASSERT_TRUE(sp->Delete(RID(PageId(0, 0), r.first)));
+  }
+  ASSERT_EQ(sp->slot_count, 0);
+  ASSERT_EQ(sp->GetFreeSpace(), SlottedPageT<kPageSize>::GetCapacity());
+  std::string largest(SlottedPageT<kPageSize>::GetCapacity() + 1, 'z');
+  uint32_t slot;
+  ASSERT_FALSE(sp->Insert(largest.data(), largest.size(), slot));
+  largest.pop_back();
+  ASSERT_TRUE(sp->Insert(largest.data(), largest.size(), slot));
+  if (largest.size() < SlottedPageT<kPageSize>::kMaxLength) {
+    ASSERT_FALSE(sp->Insert("x", 1, slot));
+  }
+  delete sp;
+}
+
+TEST(SlottedPageTests, Random) {
+  CheckSlottedPage<4096>();
+  CheckSlottedPage<8192>();
+  CheckSlottedPage<16384>();
+  CheckSlottedPage<32768>();
+  CheckSlottedPage<65536>();
+}
+
+// Holes left by deletes and shrinking updates are reused through compaction;
+// slots of deleted records are reused and keep other records' slot IDs
+TEST(SlottedPageTests, Compaction) {
+  SlottedPageT<4096> sp;
+  uint32_t capacity = SlottedPageT<4096>::GetCapacity();
+  std::string a(1000, 'a'), b(1000, 'b'), c(1000, 'c');
+  uint32_t slot;
+  ASSERT_TRUE(sp.Insert(a.data(), a.size(), slot));
+  ASSERT_TRUE(sp.Insert(b.data(), b.size(), slot));
+  ASSERT_TRUE(sp.Insert(c.data(), c.size(), slot));
+  ASSERT_EQ(slot, 2);
+  ASSERT_TRUE(sp.Delete(RID(PageId(0, 0), 1)));
+  ASSERT_EQ(sp.fragmented, 1000);
+  ASSERT_TRUE(sp.Update(RID(PageId(0, 0), 0), "a", 1));
+  ASSERT_EQ(sp.fragmented, 1999);
+
+  // Doesn't fit in the contiguous free space, but does after compaction
+  std::string d(capacity - 3 * sizeof(SlottedPageT<4096>::Slot) - 1 - 1000 + 4, 'd');
+  ASSERT_TRUE(sp.Insert(d.data(), d.size(), slot));
+  ASSERT_EQ(slot, 1);
+  ASSERT_EQ(sp.fragmented, 0);
+  ASSERT_EQ(sp.GetFreeSpace(), 0);
+
+  uint16_t length;
+  const char *record = sp.GetRecord(RID(PageId(0, 0), 0), &length);
+  ASSERT_EQ(std::string(record, length), "a");
+  record = sp.GetRecord(RID(PageId(0, 0), 2), &length);
+  ASSERT_EQ(std::string(record, length), c);
+  record = sp.GetRecord(RID(PageId(0, 0), 1), &length);
+  ASSERT_EQ(std::string(record, length), d);
+
+  // Growing needs room elsewhere in the page
+  ASSERT_FALSE(sp.Update(RID(PageId(0, 0), 0), "aa", 2));
+  ASSERT_TRUE(sp.Delete(RID(PageId(0, 0), 2)));
+  ASSERT_TRUE(sp.Update(RID(PageId(0, 0), 0), a.data(), a.size()));
+  record = sp.GetRecord(RID(PageId(0, 0), 0), &length);
+  ASSERT_EQ(std::string(record, length), a);
+  ASSERT_EQ(sp.slot_count, 2);
+}
+
+// The overflow flag of a slot follows its record through updates,
+// compaction and deletes
+TEST(SlottedPageTests, OverflowFlag) {
+  SlottedPageT<4096> sp;
+  OverflowHeader header = {100000, 7, 25};
+  std::string a(500, 'a');
+  uint32_t slot;
+  ASSERT_TRUE(sp.Insert(a.data(), a.size(), slot));
+  ASSERT_TRUE(sp.Insert((char *)&header, sizeof(header), slot, true));
+  ASSERT_EQ(slot, 1);
+  ASSERT_TRUE(sp.Delete(RID(PageId(0, 0), 0)));
+  sp.Compact();
+
+  uint16_t length;
+  bool overflow = false;
+  const char *record = sp.GetRecord(RID(PageId(0, 0), 1), &length, &overflow);
+  ASSERT_TRUE(overflow);
+  ASSERT_EQ(length, sizeof(header));
+  ASSERT_EQ(((OverflowHeader *)record)->page_count, 25);
+
+  ASSERT_TRUE(sp.Update(RID(PageId(0, 0), 1), a.data(), a.size()));
+  ASSERT_NE(sp.GetRecord(RID(PageId(0, 0), 1), &length, &overflow), nullptr);
+  ASSERT_FALSE(overflow);
+  ASSERT_TRUE(sp.Update(RID(PageId(0, 0), 1), (char *)&header, sizeof(header), true));
+  ASSERT_TRUE(sp.Delete(RID(PageId(0, 0), 1)));
+  ASSERT_TRUE(sp.Insert(a.data(), a.size(), slot));
+  ASSERT_NE(sp.GetRecord(RID(PageId(0, 0), slot), &length, &overflow), nullptr);
+  ASSERT_FALSE(overflow);
+
+  // Slot lengths have 15 bits, which 64KB pages would overflow
+  ASSERT_EQ(SlottedPageT<65536>::GetCapacity(), SlottedPageT<65536>::kMaxLength);
+  ASSERT_EQ(SlottedPageT<32768>::GetCapacity(), 32768 - 12 - sizeof(SlottedPageT<32768>::Slot));
+}
+
+// A PAX page against a model of its records: slots are taken like in a row
+// page, records come back whole, and the minipages are aligned, don't
+// overlap and hold the fields
+template <uint32_t kPageSize>
+static void CheckPaxPage(const Schema &schema) {
+  std::mt19937 rng(kPageSize + schema.size());
+  uint16_t record_size = 0;
+  for (uint16_t width : schema) {
+    record_size += width;
+  }
+  auto *pp = new PaxPageT<kPageSize>(schema.data(), schema.size());
+  uint16_t capacity = pp->capacity;
+  ASSERT_GT(capacity, 0);
+  ASSERT_LE(PaxPageT<kPageSize>::GetLayoutSize(schema.data(), schema.size(), capacity), kPageSize);
+  ASSERT_GT(PaxPageT<kPageSize>::GetLayoutSize(schema.data(), schema.size(), capacity + 1),
+            kPageSize);
+  for (uint16_t i = 0; i < schema.size(); ++i) {
+    ASSERT_EQ(pp->GetOffsets()[i] % PaxPageT<kPageSize>::kMinipageAlignment, 0);
+    if (i > 0) {
+      ASSERT_GE(pp->GetOffsets()[i], pp->GetOffsets()[i - 1] + capacity * schema[i - 1]);
+    }
+  }
+
+  std::map<uint32_t, std::string> records;
+  std::string record(record_size, 0), out(record_size, 0);
+  uint16_t hint = 0;
+  for (uint32_t i = 0; i < 20000; ++i) {
+    RID rid(PageId(0, 0), rng() % capacity);
+    for (auto &c : record) {
+      c = rng();
+    }
+    uint32_t op = rng() % 3;
+    if (op == 0) {
+      // The lowest free slot from the hint on, wrapping around
+      uint32_t expected = capacity;
+      for (uint32_t j = 0; j < capacity && expected == capacity; ++j) {
+        uint32_t candidate = (hint + j) % capacity;
+        if (!records.count(candidate)) {
+          expected = candidate;
+        }
+      }
+      uint32_t slot = 0;
+      ASSERT_EQ(pp->Insert(record.data(), slot, &hint), expected < capacity);
+      if (expected < capacity) {
+        ASSERT_EQ(slot, expected);
+        records[slot] = record;
+        rid = RID(PageId(0, 0), slot);
+      }
+    } else if (op == 1) {
+      ASSERT_EQ(pp->Delete(rid), records.erase(rid.GetSlotId()) == 1);
+    } else {
+      bool exists = records.count(rid.GetSlotId());
+      ASSERT_EQ(pp->Update(rid, record.data()), exists);
+      if (exists) {
+        records[rid.GetSlotId()] = record;
+      }
+    }
+    ASSERT_EQ(pp->GetRecordCount(), records.size());
+    bool found = pp->Read(rid, &out[0]);
+    ASSERT_EQ(found, records.count(rid.GetSlotId()) == 1);
+    if (found) {
+      ASSERT_EQ(out, records[rid.GetSlotId()]);
+    }
+  }
+
+  // The minipages hold the fields of every occupied slot
+  uint32_t field_offset = 0;
+  for (uint16_t f = 0; f < schema.size(); ++f) {
+    PaxColumn column = pp->GetColumn(f);
+    ASSERT_EQ(column.width, schema[f]);
+    ASSERT_EQ(column.slot_count, capacity);
+    for (uint32_t slot = 0; slot < capacity; ++slot) {
+      bool occupied = column.occupied[slot / 64] >> (slot % 64) & 1;
+      ASSERT_EQ(occupied, records.count(slot) == 1);
+      if (occupied) {
+        ASSERT_EQ(std::string(column.values + slot * column.width, column.width),
+                  records[slot].substr(field_offset, column.width));
+      }
+    }
+    field_offset += schema[f];
+  }
+  delete pp;
+}
+
+TEST(PaxPageTests, Random) {
+  CheckPaxPage<4096>({8, 4, 52});
+  CheckPaxPage<4096>({1});
+  CheckPaxPage<8192>({3, 5, 7, 11, 13});
+  CheckPaxPage<16384>({8, 8});
+  CheckPaxPage<32768>({2, 100, 1});
+  CheckPaxPage<65536>({4, 4, 4, 4});
+  CheckPaxPage<65536>({1, 1});
+}
+
+TEST(PaxPageTests, Capacity) {
+  Schema none, empty_field = {8, 0}, too_wide = {4096};
+  Schema too_many(PaxPageT<4096>::kMaxFields + 1, 1);
+  ASSERT_EQ(PaxPageT<4096>::GetCapacity(none.data(), none.size()), 0);
+  ASSERT_EQ(PaxPageT<4096>::GetCapacity(empty_field.data(), empty_field.size()), 0);
+  ASSERT_EQ(PaxPageT<4096>::GetCapacity(too_wide.data(), too_wide.size()), 0);
+  ASSERT_EQ(PaxPageT<4096>::GetCapacity(too_many.data(), too_many.size()), 0);
+
+  // Alignment costs little: close to a row page's capacity
+  Schema schema = {8, 4, 52};
+  uint16_t pax = GetDataPageCapacity(4096, 64, schema);
+  uint16_t row = GetDataPageCapacity(4096, 64);
+  ASSERT_LE(pax, row);
+  ASSERT_GE(pax + 2, row);
+}
+
+// Benchmark: summing one 8-byte field of 64-byte records, reading whole
+// records from row pages and the field's minipage from PAX pages
+TEST(PaxPageTests, ColumnScanBenchmark) {
+  static const uint32_t kPages = 256;
+  static const uint32_t kPasses = 20;
+  Schema schema = {8, 56};
+  std::vector<DataPage> row_pages(kPages, DataPage(64));
+  std::vector<PaxPageT<PAGE_SIZE>> pax_pages(kPages);
+  char record[64] = {0};
+  uint64_t expected = 0;
+  for (uint32_t i = 0; i < kPages; ++i) {
+    new (&pax_pages[i]) PaxPageT<PAGE_SIZE>(schema.data(), schema.size());
+    uint32_t slot;
+    for (uint64_t v = 0; pax_pages[i].GetRecordCount() < pax_pages[i].capacity; ++v) {
+      memcpy(record, &v, sizeof(v));
+      ASSERT_TRUE(row_pages[i].Insert(record, slot));
+      ASSERT_TRUE(pax_pages[i].Insert(record, slot));
+      expected += v;
+    }
+  }
+
+  uint64_t row_sum = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t pass = 0; pass < kPasses; ++pass) {
+    for (auto &dp : row_pages) {
+      for (uint32_t slot = 0; slot < DataPage::GetCapacity(64); ++slot) {
+        if (dp.Read(RID(PageId(0, 0), slot), record)) {
+          uint64_t v;
+          memcpy(&v, record, sizeof(v));
+          row_sum += v;
+        }
+      }
+    }
+  }
+  double row = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  uint64_t pax_sum = 0;
+  start = std::chrono::steady_clock::now();
+  for (uint32_t pass = 0; pass < kPasses; ++pass) {
+    for (auto &pp : pax_pages) {
+      PaxColumn column = pp.GetColumn(0);
+      const uint64_t *values = (const uint64_t *)column.values;
+      for (uint32_t word = 0; word * 64 < column.slot_count; ++word) {
+        uint64_t occupied = column.occupied[word];
+        for (; occupied; occupied &= occupied - 1) {
+          pax_sum += values[word * 64 + __builtin_ctzll(occupied)];
+        }
+      }
+    }
+  }
+  double pax = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  ASSERT_EQ(row_sum, expected * kPasses);
+  ASSERT_EQ(pax_sum, expected * kPasses);
+  std::cout << "Sum of one field over " << kPages << " pages: row pages " << row / kPasses * 1e6
+            << " us, PAX pages " << pax / kPasses * 1e6 << " us" << std::endl;
+}
+
+// Benchmark: cost of finding the free slot of an insert, by fill factor,
+// with the word-level search and the bit-level one
+TEST(DataPageTests, InsertBenchmark) {
+  static const uint32_t kIterations = 20000;
+  static const uint16_t kRecordSize = 8;
+  std::mt19937 rng(454);
+  auto *dp = new DataPageT<65536>(kRecordSize);
+  uint16_t capacity = DataPageT<65536>::GetCapacity(kRecordSize);
+  uint64_t v = 0;
+  for (double fill : {0.0, 0.5, 0.9, 0.99}) {
+    new (dp) DataPageT<65536>(kRecordSize);
+    FillPage(dp, fill, rng);
+    uint32_t slot = 0;
+    if (dp->GetRecordCount() == capacity) {
+      ASSERT_TRUE(dp->Delete(RID(PageId(0, 0), capacity - 1)));
+    }
+
+    // Insert and delete the same record, so the fill factor stays put
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < kIterations; ++i) {
+      ASSERT_TRUE(dp->Insert((char *)&v, slot));
+      ASSERT_TRUE(dp->Delete(RID(PageId(0, 0), slot)));
+    }
+    double fast = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    uint32_t found = 0;
+    start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < kIterations; ++i) {
+      found += FindFreeSlotSlow(dp, 0, capacity);
+    }
+    double slow = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    ASSERT_EQ(found, (uint64_t)slot * kIterations);
+
+    std::cout << "Insert into 64K page " << fill * 100 << "% full: " << fast / kIterations * 1e9
+              << " ns (bit-level search alone: " << slow / kIterations * 1e9 << " ns)"
+              << std::endl;
+  }
+  delete dp;
+}
+
+}  // namespace yase
+
+int main(int argc, char **argv) {
+  ::google::InitGoogleLogging(argv[0]);
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
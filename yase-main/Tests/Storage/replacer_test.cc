@@ -0,0 +1,227 @@
+/*
+ * YASE: Yet Another Storage Engine
+ *
+ * CMPT 454 Database Systems II, Spring 2025
+ *
+ * Copyright (C) School of Computing Science, Simon Fraser University
+ *
+ * Not for distribution without prior approval.
+ *
+ * Test cases for page replacement policies.
+ */
+
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <memory>
+
+#include <Storage/buffer_manager.h>
+#include <Storage/replacer.h>
+
+namespace yase {
+
+static const uint32_t kFrameCount = 4;
+class ReplacerTests : public ::testing::Test {
+ protected:
+  Page frames[kFrameCount];
+
+  // Make every frame hold an unpinned page
+  void SetUp() override {
+    for (uint32_t i = 0; i < kFrameCount; ++i) {
+      frames[i].frame_id = i;
+      frames[i].page_id = PageId(1, i);
+    }
+  }
+};
+
+// Unreferenced frames are evicted first
+TEST_F(ReplacerTests, ClockUnreferenced) {
+  ClockReplacer replacer(frames, kFrameCount);
+  replacer.RecordAccess(0);
+  replacer.RecordAccess(1);
+  replacer.RecordAccess(3);
+  ASSERT_EQ(replacer.Evict(), 2);
+}
+
+// Referenced frames get a second chance, in clock order
+TEST_F(ReplacerTests, ClockSecondChance) {
+  ClockReplacer replacer(frames, kFrameCount);
+  for (uint32_t i = 0; i < kFrameCount; ++i) {
+    replacer.RecordAccess(i);
+  }
+  ASSERT_EQ(replacer.Evict(), 0);
+  ASSERT_EQ(replacer.Evict(), 1);
+
+  // Touching frame 2 again saves it from the next sweep
+  replacer.RecordAccess(2);
+  ASSERT_EQ(replacer.Evict(), 3);
+}
+
+// Pinned and empty frames are never evicted
+TEST_F(ReplacerTests, ClockSkipPinned) {
+  ClockReplacer replacer(frames, kFrameCount);
+  frames[0].pin_count = 1;
+  frames[1].pin_count = 2;
+  frames[2].page_id = PageId();
+  ASSERT_EQ(replacer.Evict(), 3);
+
+  frames[3].pin_count = 1;
+  ASSERT_EQ(replacer.Evict(), Page::kInvalidFrame);
+}
+
+// LRU evicts in order of last access
+TEST_F(ReplacerTests, LRU) {
+  LRUReplacer replacer(frames, kFrameCount);
+  for (uint32_t i = 0; i < kFrameCount; ++i) {
+    replacer.RecordLoad(i);
+  }
+  replacer.RecordAccess(0);
+  ASSERT_EQ(replacer.Evict(), 1);
+  replacer.Remove(1);
+
+  frames[2].pin_count = 1;
+  ASSERT_EQ(replacer.Evict(), 3);
+}
+
+// LRU-K evicts pages referenced once before pages referenced twice
+TEST_F(ReplacerTests, LRUK) {
+  LRUKReplacer replacer(frames, kFrameCount);
+  for (uint32_t i = 0; i < kFrameCount; ++i) {
+    replacer.RecordLoad(i);
+  }
+  replacer.RecordAccess(0);
+  replacer.RecordAccess(1);
+  replacer.RecordAccess(3);
+  ASSERT_EQ(replacer.Evict(), 2);
+  replacer.Remove(2);
+
+  // Among pages referenced twice, the oldest second-to-last reference loses
+  frames[2].page_id = PageId();
+  ASSERT_EQ(replacer.Evict(), 0);
+  replacer.RecordAccess(0);
+  ASSERT_EQ(replacer.Evict(), 1);
+}
+
+// 2Q keeps re-referenced pages out of the reach of a scan
+TEST_F(ReplacerTests, TwoQ) {
+  TwoQReplacer replacer(frames, kFrameCount);
+  for (uint32_t i = 0; i < kFrameCount; ++i) {
+    replacer.RecordLoad(i);
+  }
+
+  // Evict page 0 from A1in; loading it again promotes it to Am
+  ASSERT_EQ(replacer.Evict(), 0);
+  replacer.Remove(0);
+  replacer.RecordLoad(0);
+  ASSERT_EQ(replacer.queue[0], TwoQReplacer::Am);
+
+  // Scan pages replace each other in A1in while page 0 stays
+  for (uint32_t i = 0; i < 10; ++i) {
+    uint32_t victim = replacer.Evict();
+    ASSERT_NE(victim, 0);
+    replacer.Remove(victim);
+    frames[victim].page_id = PageId(2, i);
+    replacer.RecordLoad(victim);
+  }
+}
+
+// ARC promotes re-referenced pages to T2 and adapts on ghost hits
+TEST_F(ReplacerTests, ARC) {
+  ARCReplacer replacer(frames, kFrameCount);
+  for (uint32_t i = 0; i < kFrameCount; ++i) {
+    replacer.RecordLoad(i);
+  }
+  replacer.RecordAccess(0);
+  ASSERT_EQ(replacer.queue[0], ARCReplacer::T2);
+
+  // Evicting from T1 leaves a ghost in B1
+  uint32_t victim = replacer.Evict();
+  ASSERT_EQ(victim, 1);
+  PageId pid = frames[victim].page_id;
+  replacer.Remove(victim);
+  ASSERT_EQ(replacer.b1.size, 1);
+
+  // A B1 hit grows the target size of T1 and goes to T2
+  replacer.RecordLoad(victim);
+  ASSERT_EQ(frames[victim].page_id.value, pid.value);
+  ASSERT_EQ(replacer.b1.size, 0);
+  ASSERT_EQ(replacer.p, 1);
+  ASSERT_EQ(replacer.queue[victim], ARCReplacer::T2);
+}
+
+// Ghost entries are found by page ID and forgotten oldest first, holes left
+// by taken entries included
+TEST(GhostListTests, Fifo) {
+  GhostList ghosts(3);
+  for (uint32_t i = 0; i < 3; ++i) {
+    ghosts.Add(PageId(1, i));
+  }
+  ASSERT_TRUE(ghosts.Take(PageId(1, 0)));
+  ASSERT_FALSE(ghosts.Take(PageId(1, 0)));
+  ASSERT_EQ(ghosts.size, 2);
+
+  // Page 1 is the oldest left
+  ghosts.DropOldest();
+  ASSERT_EQ(ghosts.size, 1);
+  ASSERT_FALSE(ghosts.Take(PageId(1, 1)));
+
+  // Adding to a full list forgets the oldest entry
+  for (uint32_t i = 3; i < 5; ++i) {
+    ghosts.Add(PageId(1, i));
+  }
+  ghosts.Add(PageId(1, 5));
+  ASSERT_EQ(ghosts.size, 3);
+  ASSERT_FALSE(ghosts.Take(PageId(1, 2)));
+  for (uint32_t i = 3; i < 6; ++i) {
+    ASSERT_TRUE(ghosts.Take(PageId(1, i)));
+  }
+  ASSERT_EQ(ghosts.size, 0);
+  ASSERT_TRUE(ghosts.index.empty());
+}
+
+// Dropped frames leave the LRU-K order until loaded again
+TEST_F(ReplacerTests, LRUKDroppedFrame) {
+  LRUKReplacer replacer(frames, kFrameCount);
+  for (uint32_t i = 0; i < kFrameCount; ++i) {
+    replacer.RecordLoad(i);
+  }
+  replacer.Remove(0);
+  replacer.RecordAccess(0);
+  ASSERT_EQ(replacer.order.size(), kFrameCount - 1);
+  ASSERT_EQ(replacer.Evict(), 1);
+  replacer.RecordLoad(0);
+  ASSERT_EQ(replacer.order.size(), kFrameCount);
+}
+
+// An access to a dropped frame doesn't put it back in a list
+TEST_F(ReplacerTests, ARCDroppedFrame) {
+  ARCReplacer replacer(frames, kFrameCount);
+  replacer.RecordLoad(0);
+  replacer.Remove(0);
+  replacer.RecordAccess(0);
+  ASSERT_EQ(replacer.queue[0], ARCReplacer::None);
+  ASSERT_EQ(replacer.t2.size, 0);
+}
+
+// Every policy skips pinned frames
+TEST_F(ReplacerTests, AllSkipPinned) {
+  Replacer::Policy policies[] = {Replacer::LRU, Replacer::Clock, Replacer::LRUK,
+                                 Replacer::TwoQ, Replacer::ARC};
+  for (auto policy : policies) {
+    std::unique_ptr<Replacer> replacer(Replacer::Create(policy, frames, kFrameCount));
+    for (uint32_t i = 0; i < kFrameCount; ++i) {
+      frames[i].pin_count = i == 2 ? 0 : 1;
+      replacer->RecordLoad(i);
+    }
+    ASSERT_EQ(replacer->Evict(), 2);
+    frames[2].pin_count = 1;
+    ASSERT_EQ(replacer->Evict(), Page::kInvalidFrame);
+  }
+}
+
+}  // namespace yase
+
+int main(int argc, char **argv) {
+  ::google::InitGoogleLogging(argv[0]);
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -11,8 +11,12 @@
  */
 
 #include <assert.h>
+#include <chrono>
 #include <iostream>
+#include <map>
 #include <memory>
+#include <random>
+#include <string>
 #include <cstdio>
 
 #include <glog/logging.h>
@@ -89,6 +93,609 @@ GTEST_TEST(Table, SimpleTableTest) {
   yase::BufferManager::Uninitialize();
 }
 
+// A table with large pages fits more records per page, and its pages
+// survive eviction from their own size class
+GTEST_TEST(Table, LargePages) {
+  static const uint32_t kRecordSize = 8;
+  static const uint32_t kPageSize = 32768;
+  static const uint32_t kPages = 20;
+
+  yase::BufferManager::Initialize({{PAGE_SIZE, 10}, {kPageSize, 4}});
+  {
+    yase::Table table("mytable_large", kRecordSize, false, kPageSize);
+    uint16_t max_nrecs_per_page = yase::GetDataPageCapacity(kPageSize, kRecordSize);
+    ASSERT_EQ(max_nrecs_per_page, yase::DataPageT<kPageSize>::GetCapacity(kRecordSize));
+    ASSERT_GT(max_nrecs_per_page, 7 * yase::DataPage::GetCapacity(kRecordSize));
+
+    for (uint32_t p = 0; p < kPages; ++p) {
+      for (uint64_t i = 0; i < max_nrecs_per_page; ++i) {
+        uint64_t v = p * max_nrecs_per_page + i;
+        yase::RID rid = table.Insert((char *)&v);
+        ASSERT_TRUE(rid.IsValid());
+        ASSERT_EQ(rid.GetSlotId(), i);
+        ASSERT_EQ(rid.GetPageNum(), p);
+      }
+    }
+
+    for (uint32_t p = 0; p < kPages; ++p) {
+      for (uint64_t i = 0; i < max_nrecs_per_page; i += 97) {
+        yase::RID rid(yase::PageId(table.GetFileId(), p), i);
+        uint64_t value = 0;
+        ASSERT_TRUE(table.Read(rid, &value));
+        ASSERT_EQ(value, p * max_nrecs_per_page + i);
+        ASSERT_TRUE(table.Delete(rid));
+        ASSERT_FALSE(table.Read(rid, &value));
+      }
+    }
+  }
+  yase::BufferManager::Uninitialize();
+  int ret = system("rm -rf mytable_large mytable_large.dir");
+  LOG_IF(FATAL, ret == -1) << "Error cleaning up testing files";
+}
+
+// Inserts fill slots freed by deletes instead of growing the table, also
+// after reopening it
+GTEST_TEST(Table, ReuseFreedSlots) {
+  static const uint32_t kRecordSize = 8;
+  static const uint32_t kPages = 20;
+  static const uint32_t kRounds = 10;
+
+  yase::BufferManager::Initialize(10);
+  uint16_t per_page = yase::DataPage::GetCapacity(kRecordSize);
+  std::vector<yase::RID> rids;
+  {
+    yase::Table table("mytable_reuse", kRecordSize);
+    for (uint64_t i = 0; i < kPages * per_page; ++i) {
+      rids.push_back(table.Insert((char *)&i));
+      ASSERT_TRUE(rids.back().IsValid());
+    }
+    ASSERT_EQ(table.file.GetPageCount(), kPages);
+
+    // Delete-heavy workload: replace a tenth of the records, over and over
+    for (uint32_t r = 0; r < kRounds; ++r) {
+      for (uint32_t i = r; i < rids.size(); i += kRounds) {
+        ASSERT_TRUE(table.Delete(rids[i]));
+      }
+      for (uint32_t i = r; i < rids.size(); i += kRounds) {
+        uint64_t v = i;
+        rids[i] = table.Insert((char *)&v);
+        ASSERT_TRUE(rids[i].IsValid());
+      }
+    }
+    ASSERT_EQ(table.file.GetPageCount(), kPages);
+    for (uint32_t i = 0; i < rids.size(); i += 37) {
+      uint64_t value = 0;
+      ASSERT_TRUE(table.Read(rids[i], &value));
+      ASSERT_EQ(value, i);
+    }
+
+    // Leave holes in pages 3 and 7 behind
+    ASSERT_TRUE(table.Delete(yase::RID(yase::PageId(table.GetFileId(), 7), 5)));
+    ASSERT_TRUE(table.Delete(yase::RID(yase::PageId(table.GetFileId(), 3), 1)));
+  }
+  yase::BufferManager::Uninitialize();
+
+  yase::BufferManager::Initialize(10);
+  {
+    yase::Table table("mytable_reuse", kRecordSize, false, PAGE_SIZE, true);
+    uint64_t v = 0;
+    ASSERT_EQ(table.Insert((char *)&v).GetPageNum(), 3);
+    ASSERT_EQ(table.Insert((char *)&v).GetPageNum(), 7);
+    ASSERT_EQ(table.Insert((char *)&v).GetPageNum(), kPages);
+  }
+  yase::BufferManager::Uninitialize();
+  int ret = system("rm -rf mytable_reuse mytable_reuse.dir");
+  LOG_IF(FATAL, ret == -1) << "Error cleaning up testing files";
+}
+
+// Pages allocated in bulk are formatted when first inserted into
+GTEST_TEST(Table, BulkAllocatedPages) {
+  static const uint32_t kRecordSize = 8;
+  static const uint32_t kPages = 5;
+
+  yase::BufferManager::Initialize(10);
+  {
+    yase::Table table("mytable_bulk", kRecordSize);
+    ASSERT_EQ(table.file.AllocatePages(kPages).GetPageNum(), 1);
+    uint16_t per_page = yase::DataPage::GetCapacity(kRecordSize);
+    std::vector<yase::RID> rids;
+    for (uint64_t i = 0; i < (kPages + 1) * per_page; ++i) {
+      rids.push_back(table.Insert((char *)&i));
+      ASSERT_TRUE(rids.back().IsValid());
+      ASSERT_EQ(rids.back().GetPageNum(), i / per_page);
+    }
+    ASSERT_EQ(table.file.GetPageCount(), kPages + 1);
+    for (uint32_t i = 0; i < rids.size(); i += 41) {
+      uint64_t value = 0;
+      ASSERT_TRUE(table.Read(rids[i], &value));
+      ASSERT_EQ(value, i);
+    }
+  }
+  yase::BufferManager::Uninitialize();
+  int ret = system("rm -rf mytable_bulk mytable_bulk.dir");
+  LOG_IF(FATAL, ret == -1) << "Error cleaning up testing files";
+}
+
+// Variable-length records are stored at their actual size and survive a
+// reopen
+GTEST_TEST(Table, VariableLength) {
+  static const uint32_t kRecords = 2000;
+  static const uint32_t kMaxLength = 400;
+
+  yase::BufferManager::Initialize(10);
+  std::mt19937 rng(454);
+  std::vector<yase::RID> rids;
+  std::vector<std::string> records;
+  uint64_t bytes = 0;
+  {
+    yase::Table table("mytable_var", yase::kVariableRecordSize);
+    ASSERT_TRUE(table.IsVariable());
+    ASSERT_FALSE(table.Insert("", 0).IsValid());
+    for (uint32_t i = 0; i < kRecords; ++i) {
+      records.push_back(std::string(1 + rng() % kMaxLength, 'a' + i % 26));
+      rids.push_back(table.Insert(records[i].data(), records[i].size()));
+      ASSERT_TRUE(rids[i].IsValid());
+      bytes += records[i].size();
+    }
+
+    // Pages are filled to well over what padding to the maximum length gives
+    uint64_t padded_pages = kRecords / (PAGE_SIZE / kMaxLength) + 1;
+    ASSERT_LT(table.file.GetPageCount(), padded_pages * 2 / 3);
+    ASSERT_LE(table.file.GetPageCount(), bytes / (PAGE_SIZE * 3 / 4) + 1);
+    std::cout << "Variable-length records: " << bytes << " bytes in "
+              << table.file.GetPageCount() << " pages (" << padded_pages << " padded)"
+              << std::endl;
+
+    // Shrinking and growing in place; space freed by deletes is reused
+    ASSERT_TRUE(table.Update(rids[0], "tiny", 4));
+    records[0] = "tiny";
+    std::string longer(records[1].size() + 10, 'L');
+    if (table.Update(rids[1], longer.data(), longer.size())) {
+      records[1] = longer;
+    }
+    uint32_t pages = table.file.GetPageCount();
+    for (uint32_t i = 2; i < kRecords; i += 2) {
+      ASSERT_TRUE(table.Delete(rids[i]));
+    }
+    for (uint32_t i = 2; i < kRecords; i += 2) {
+      rids[i] = table.Insert(records[i].data(), records[i].size());
+      ASSERT_TRUE(rids[i].IsValid());
+    }
+    ASSERT_LE(table.file.GetPageCount(), pages + 1);
+
+    uint64_t v;
+    ASSERT_FALSE(table.Read(rids[0], &v));
+  }
+  yase::BufferManager::Uninitialize();
+
+  yase::BufferManager::Initialize(10);
+  {
+    yase::Table table("mytable_var", yase::kVariableRecordSize, false, PAGE_SIZE, true);
+    for (uint32_t i = 0; i < kRecords; ++i) {
+      std::string record;
+      ASSERT_TRUE(table.Read(yase::RID(yase::PageId(table.GetFileId(), rids[i].GetPageNum()),
+                                       rids[i].GetSlotId()), &record));
+      ASSERT_EQ(record, records[i]);
+    }
+  }
+  yase::BufferManager::Uninitialize();
+  int ret = system("rm -rf mytable_var mytable_var.dir");
+  LOG_IF(FATAL, ret == -1) << "Error cleaning up testing files";
+}
+
+// Records longer than a page go to overflow pages, written and read through
+// the buffer pool a page at a time; the pages are freed with the record
+GTEST_TEST(Table, Overflow) {
+  yase::BufferManager::Initialize(10);
+  // Byte i of record r, so pieces can be checked wherever they fall
+  auto byte = [](uint32_t r, uint64_t i) { return (char)(r * 31 + i * 7 + i / 4093); };
+  std::vector<uint64_t> lengths;
+  std::vector<yase::RID> rids;
+  {
+    yase::Table table("mytable_overflow", yase::kVariableRecordSize);
+    uint32_t capacity = table.file.page_capacity;
+    uint32_t overflow_capacity = table.GetOverflowCapacity();
+    lengths = {capacity, capacity + 1, overflow_capacity * 3 + 100, 4 * 1024 * 1024, 10};
+    for (uint32_t r = 0; r < lengths.size(); ++r) {
+      uint64_t written = 0;
+      rids.push_back(table.StreamInsert(lengths[r], [&](char *buf, uint32_t n) {
+        ASSERT_LE(n, std::max(overflow_capacity, capacity));
+        for (uint32_t i = 0; i < n; ++i) {
+          buf[i] = byte(r, written + i);
+        }
+        written += n;
+      }));
+      ASSERT_TRUE(rids[r].IsValid());
+      ASSERT_EQ(written, lengths[r]);
+    }
+    // The 4MB record was never materialized. Overflow pages aren't offered
+    // for inserts: the OverflowHeaders and the short record share a page.
+    uint32_t pages = table.file.GetPageCount();
+    ASSERT_GE(pages, 4 * 1024 * 1024 / overflow_capacity);
+    ASSERT_EQ(rids[2].GetPageNum(), rids[1].GetPageNum());
+    ASSERT_EQ(rids[3].GetPageNum(), rids[1].GetPageNum());
+    ASSERT_EQ(rids[4].GetPageNum(), rids[1].GetPageNum());
+
+    // RIDs pointing into an overflow page refer to nothing
+    yase::PageId overflow_pid;
+    for (uint32_t page_num = 0; page_num < pages && !overflow_pid.IsValid(); ++page_num) {
+      yase::PageId pid(table.GetFileId(), page_num);
+      yase::Page *p = yase::BufferManager::Get()->PinPage(pid);
+      ASSERT_NE(p, nullptr);
+      if (table.IsOverflowPage(p)) {
+        overflow_pid = pid;
+      }
+      yase::BufferManager::Get()->UnpinPage(p);
+    }
+    ASSERT_TRUE(overflow_pid.IsValid());
+    std::string bogus;
+    for (uint16_t slot = 0; slot < 3; ++slot) {
+      yase::RID rid(overflow_pid, slot);
+      ASSERT_FALSE(table.Read(rid, &bogus));
+      ASSERT_FALSE(table.Update(rid, "xyz", 3));
+      ASSERT_FALSE(table.Delete(rid));
+    }
+
+    for (uint32_t r = 0; r < lengths.size(); ++r) {
+      uint64_t read = 0;
+      uint32_t pieces = 0;
+      bool match = true;
+      ASSERT_TRUE(table.StreamRead(rids[r], [&](const char *buf, uint32_t n) {
+        for (uint32_t i = 0; i < n; ++i) {
+          match &= buf[i] == byte(r, read + i);
+        }
+        read += n;
+        ++pieces;
+      }));
+      ASSERT_TRUE(match);
+      ASSERT_EQ(read, lengths[r]);
+      ASSERT_EQ(pieces, lengths[r] <= capacity ? 1 : (lengths[r] - 1) / overflow_capacity + 1);
+    }
+
+    // Whole-record APIs go through the same pages
+    std::string record(lengths[2], 0);
+    for (uint64_t i = 0; i < record.size(); ++i) {
+      record[i] = byte(7, i);
+    }
+    yase::RID rid = table.Insert(record.data(), record.size());
+    std::string out;
+    ASSERT_TRUE(table.Read(rid, &out));
+    ASSERT_EQ(out, record);
+
+    // Shrinking and deleting give the overflow pages back to the file, for
+    // the next record to reuse
+    ASSERT_TRUE(table.Update(rid, "short", 5));
+    ASSERT_TRUE(table.Read(rid, &out));
+    ASSERT_EQ(out, "short");
+    ASSERT_TRUE(table.Delete(rids[3]));
+    ASSERT_FALSE(table.Read(rids[3], &out));
+    ASSERT_EQ(table.file.free_page_count, 4 * 1024 * 1024 / overflow_capacity + 1 + 4);
+    ASSERT_TRUE(table.Update(rid, record.data(), record.size()));
+    ASSERT_TRUE(table.Read(rid, &out));
+    ASSERT_EQ(out, record);
+    ASSERT_EQ(table.file.GetPageCount(), pages + 4);
+  }
+  yase::BufferManager::Uninitialize();
+
+  yase::BufferManager::Initialize(10);
+  {
+    yase::Table table("mytable_overflow", yase::kVariableRecordSize, false, PAGE_SIZE, true);
+    std::string out;
+    for (uint32_t r : {0, 1, 2, 4}) {
+      ASSERT_TRUE(table.Read(yase::RID(yase::PageId(table.GetFileId(), rids[r].GetPageNum()),
+                                       rids[r].GetSlotId()), &out));
+      ASSERT_EQ(out.size(), lengths[r]);
+      for (uint64_t i = 0; i < out.size(); ++i) {
+        ASSERT_EQ(out[i], byte(r, i));
+      }
+    }
+  }
+  yase::BufferManager::Uninitialize();
+  int ret = system("rm -rf mytable_overflow mytable_overflow.dir");
+  LOG_IF(FATAL, ret == -1) << "Error cleaning up testing files";
+}
+
+// A PAX table reads and writes whole records like a row table, and scans
+// columns page by page; it survives a reopen with its schema
+GTEST_TEST(Table, Pax) {
+  struct Row {
+    uint64_t id;
+    uint32_t quantity;
+    char comment[52];
+  };
+  static_assert(sizeof(Row) == 64, "Unexpected row size");
+  static const yase::Schema kSchema = {8, 4, 52};
+  static const uint32_t kRecords = 3000;
+
+  yase::BufferManager::Initialize(10);
+  std::vector<yase::RID> rids;
+  uint64_t id_sum = 0, quantity_sum = 0;
+  {
+    yase::Table table("mytable_pax", sizeof(Row), false, PAGE_SIZE, false, kSchema);
+    ASSERT_TRUE(table.IsPax());
+    for (uint64_t i = 0; i < kRecords; ++i) {
+      Row row = {i, (uint32_t)(i % 7), {0}};
+      snprintf(row.comment, sizeof(row.comment), "row %lu", (unsigned long)i);
+      rids.push_back(table.Insert((char *)&row));
+      ASSERT_TRUE(rids.back().IsValid());
+      id_sum += i;
+      quantity_sum += i % 7;
+    }
+    ASSERT_EQ(table.file.GetPageCount(), kRecords / table.file.page_capacity + 1);
+
+    Row row;
+    ASSERT_TRUE(table.Read(rids[1234], &row));
+    ASSERT_EQ(row.id, 1234);
+    ASSERT_STREQ(row.comment, "row 1234");
+    row.quantity = 100;
+    ASSERT_TRUE(table.Update(rids[1234], (char *)&row));
+    quantity_sum += 100 - 1234 % 7;
+    ASSERT_TRUE(table.Delete(rids[7]));
+    ASSERT_FALSE(table.Read(rids[7], &row));
+    id_sum -= 7;
+    quantity_sum -= 7 % 7;
+
+    // A column scan sees the updates and deletes, without the other fields
+    uint64_t ids = 0, quantities = 0, records = 0;
+    ASSERT_TRUE(table.ScanColumns({0, 1}, [&](yase::PageId pid, const yase::PaxColumn *columns) {
+      const uint64_t *id = (const uint64_t *)columns[0].values;
+      const uint32_t *quantity = (const uint32_t *)columns[1].values;
+      for (uint32_t slot = 0; slot < columns[0].slot_count; ++slot) {
+        if (columns[0].occupied[slot / 64] >> (slot % 64) & 1) {
+          ids += id[slot];
+          quantities += quantity[slot];
+          ++records;
+        }
+      }
+    }));
+    ASSERT_EQ(ids, id_sum);
+    ASSERT_EQ(quantities, quantity_sum);
+    ASSERT_EQ(records, kRecords - 1);
+    ASSERT_FALSE(table.ScanColumns({3}, [](yase::PageId, const yase::PaxColumn *) {}));
+  }
+  yase::BufferManager::Uninitialize();
+
+  yase::BufferManager::Initialize(10);
+  {
+    yase::Table table("mytable_pax", sizeof(Row), false, PAGE_SIZE, true, kSchema);
+    uint64_t ids = 0;
+    ASSERT_TRUE(table.ScanColumns({0}, [&](yase::PageId pid, const yase::PaxColumn *columns) {
+      for (uint32_t slot = 0; slot < columns[0].slot_count; ++slot) {
+        if (columns[0].occupied[slot / 64] >> (slot % 64) & 1) {
+          ids += ((const uint64_t *)columns[0].values)[slot];
+        }
+      }
+    }));
+    ASSERT_EQ(ids, id_sum);
+
+    // Keeps filling the hole left by the delete
+    Row row = {7, 0, {0}};
+    yase::RID rid = table.Insert((char *)&row);
+    ASSERT_EQ(rid.GetPageNum(), rids[7].GetPageNum());
+    ASSERT_EQ(rid.GetSlotId(), rids[7].GetSlotId());
+
+    yase::Table row_table("mytable_pax_row", sizeof(Row));
+    ASSERT_FALSE(row_table.ScanColumns({0}, [](yase::PageId, const yase::PaxColumn *) {}));
+  }
+  yase::BufferManager::Uninitialize();
+  int ret = system("rm -rf mytable_pax mytable_pax.dir mytable_pax_row mytable_pax_row.dir");
+  LOG_IF(FATAL, ret == -1) << "Error cleaning up testing files";
+}
+
+// Collect the records of [table] through a scan, by RID
+static std::map<uint64_t, std::string> ScanAll(yase::Table &table) {
+  std::map<uint64_t, std::string> records;
+  auto scan = table.Scan();
+  std::vector<yase::ScanRecord> batch;
+  while (scan->Next(&batch)) {
+    EXPECT_FALSE(batch.empty());
+    for (auto &r : batch) {
+      EXPECT_EQ(r.rid.GetPageNum(), batch[0].rid.GetPageNum());
+      EXPECT_EQ(records.count(r.rid.value), 0);
+      records[r.rid.value] = r.record ? std::string(r.record, r.length)
+                                      : std::string(r.length, '?');
+    }
+  }
+  return records;
+}
+
+// A scan sees every record once, a page at a time, skipping deallocated and
+// never used pages, whatever the page layout
+GTEST_TEST(Table, Scan) {
+  yase::BufferManager::Initialize(10);
+  {
+    // Fixed-size records, with holes, a deallocated page and pages
+    // allocated in bulk but unused
+    yase::Table table("mytable_scan", 8);
+    std::map<uint64_t, std::string> expected;
+    std::vector<yase::RID> rids;
+    for (uint64_t i = 0; i < table.file.page_capacity * 30; ++i) {
+      rids.push_back(table.Insert((char *)&i));
+      ASSERT_TRUE(rids.back().IsValid());
+      expected[rids.back().value] = std::string((char *)&i, 8);
+    }
+    for (uint32_t i = 0; i < rids.size(); i += 3) {
+      ASSERT_TRUE(table.Delete(rids[i]));
+      expected.erase(rids[i].value);
+    }
+    for (uint32_t slot = 0; slot < table.file.page_capacity; ++slot) {
+      yase::RID rid(yase::PageId(table.GetFileId(), 5), slot);
+      if (expected.erase(rid.value)) {
+        ASSERT_TRUE(table.Delete(rid));
+      }
+    }
+    ASSERT_TRUE(table.file.DeallocatePage(yase::PageId(table.GetFileId(), 5)));
+    ASSERT_TRUE(table.file.AllocatePages(20).IsValid());
+    ASSERT_EQ(ScanAll(table), expected);
+
+    // The cursor can stop early; the page is released
+    auto scan = table.Scan();
+    std::vector<yase::ScanRecord> batch;
+    ASSERT_TRUE(scan->Next(&batch));
+    scan->Close();
+    uint64_t v = 1;
+    ASSERT_TRUE(table.Insert((char *)&v).IsValid());
+  }
+  {
+    // Variable-length records, one of them in overflow pages
+    yase::Table table("mytable_scan_var", yase::kVariableRecordSize);
+    std::map<uint64_t, std::string> expected;
+    for (uint32_t i = 0; i < 500; ++i) {
+      std::string record(1 + i % 300, 'a' + i % 26);
+      yase::RID rid = table.Insert(record.data(), record.size());
+      ASSERT_TRUE(rid.IsValid());
+      expected[rid.value] = record;
+    }
+    std::string large(PAGE_SIZE * 5, 'L');
+    yase::RID rid = table.Insert(large.data(), large.size());
+    ASSERT_TRUE(rid.IsValid());
+    expected[rid.value] = std::string(large.size(), '?');
+    ASSERT_EQ(ScanAll(table), expected);
+  }
+  {
+    // PAX pages: records are gathered whole
+    yase::Table table("mytable_scan_pax", 12, false, PAGE_SIZE, false, {4, 8});
+    std::map<uint64_t, std::string> expected;
+    for (uint32_t i = 0; i < 1000; ++i) {
+      char record[12];
+      memcpy(record, &i, 4);
+      uint64_t w = i * 3;
+      memcpy(record + 4, &w, 8);
+      yase::RID rid = table.Insert(record);
+      ASSERT_TRUE(rid.IsValid());
+      expected[rid.value] = std::string(record, 12);
+    }
+    ASSERT_EQ(ScanAll(table), expected);
+  }
+  yase::BufferManager::Uninitialize();
+  int ret = system("rm -rf mytable_scan mytable_scan.dir mytable_scan_var mytable_scan_var.dir "
+                   "mytable_scan_pax mytable_scan_pax.dir");
+  LOG_IF(FATAL, ret == -1) << "Error cleaning up testing files";
+}
+
+// Benchmark: reading every record of a reopened table, with Read for each
+// RID of a side list and with a scan
+GTEST_TEST(Table, ScanBenchmark) {
+  static const uint32_t kPages = 500;
+  std::vector<yase::RID> rids;
+  yase::BufferManager::Initialize(64);
+  {
+    yase::Table table("mytable_scan_bench", 8);
+    for (uint64_t i = 0; i < (uint64_t)kPages * table.file.page_capacity; ++i) {
+      rids.push_back(table.Insert((char *)&i));
+    }
+  }
+  yase::BufferManager::Uninitialize();
+
+  uint64_t expected = (uint64_t)rids.size() * (rids.size() - 1) / 2;
+  double secs[2];
+  for (int use_scan = 0; use_scan < 2; ++use_scan) {
+    yase::BufferManager::Initialize(64);
+    {
+      yase::Table table("mytable_scan_bench", 8, false, PAGE_SIZE, true);
+      uint64_t sum = 0;
+      auto start = std::chrono::steady_clock::now();
+      if (use_scan) {
+        auto scan = table.Scan();
+        std::vector<yase::ScanRecord> batch;
+        while (scan->Next(&batch)) {
+          for (auto &r : batch) {
+            sum += *(const uint64_t *)r.record;
+          }
+        }
+      } else {
+        for (auto &rid : rids) {
+          uint64_t v;
+          ASSERT_TRUE(table.Read(yase::RID(yase::PageId(table.GetFileId(), rid.GetPageNum()),
+                                           rid.GetSlotId()), &v));
+          sum += v;
+        }
+      }
+      secs[use_scan] =
+          std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      ASSERT_EQ(sum, expected);
+    }
+    yase::BufferManager::Uninitialize();
+  }
+  std::cout << "Read " << rids.size() << " records in " << kPages << " pages: " << secs[0] * 1000
+            << " ms by RID, " << secs[1] * 1000 << " ms by scan" << std::endl;
+  int ret = system("rm -rf mytable_scan_bench mytable_scan_bench.dir");
+  LOG_IF(FATAL, ret == -1) << "Error cleaning up testing files";
+}
+
+// A reopened table serves the records it had and keeps filling its last page
+GTEST_TEST(Table, Reopen) {
+  static const uint32_t kRecordSize = 8;
+  static const uint32_t kRecords = 1500;
+
+  yase::BufferManager::Initialize(10);
+  std::vector<yase::RID> rids;
+  {
+    yase::Table table("mytable_reopen", kRecordSize);
+    for (uint64_t i = 0; i < kRecords; ++i) {
+      rids.push_back(table.Insert((char *)&i));
+      ASSERT_TRUE(rids.back().IsValid());
+    }
+  }
+  yase::BufferManager::Uninitialize();
+
+  yase::BufferManager::Initialize(10);
+  {
+    yase::Table table("mytable_reopen", kRecordSize, false, PAGE_SIZE, true);
+    ASSERT_EQ(table.next_free_pid.GetPageNum(), rids.back().GetPageNum());
+    for (uint64_t i = 0; i < kRecords; ++i) {
+      uint64_t value = 0;
+      yase::RID rid(yase::PageId(table.GetFileId(), rids[i].GetPageNum()), rids[i].GetSlotId());
+      ASSERT_TRUE(table.Read(rid, &value));
+      ASSERT_EQ(value, i);
+    }
+    uint64_t v = kRecords;
+    yase::RID rid = table.Insert((char *)&v);
+    ASSERT_EQ(rid.GetPageNum(), rids.back().GetPageNum());
+    ASSERT_EQ(rid.GetSlotId(), rids.back().GetSlotId() + 1);
+  }
+  yase::BufferManager::Uninitialize();
+  int ret = system("rm -rf mytable_reopen mytable_reopen.dir");
+  LOG_IF(FATAL, ret == -1) << "Error cleaning up testing files";
+}
+
+// Benchmark: time to reopen a table, by table size. Only the directory is
+// read, so startup grows with the number of directory pages, not data pages;
+// all but the last page are deallocated so the whole directory is searched.
+GTEST_TEST(Table, StartupTime) {
+  static const uint32_t kRecordSize = 8;
+  static const uint32_t kSizes[] = {1024, 8192, 32768};
+
+  for (uint32_t pages : kSizes) {
+    yase::BufferManager::Initialize(256);
+    {
+      yase::Table table("mytable_startup", kRecordSize);
+      for (uint32_t i = 1; i < pages; ++i) {
+        ASSERT_TRUE(table.file.AllocatePage().IsValid());
+      }
+      for (uint32_t i = 0; i < pages - 1; ++i) {
+        ASSERT_TRUE(table.file.DeallocatePage(yase::PageId(table.GetFileId(), i)));
+      }
+    }
+    yase::BufferManager::Uninitialize();
+
+    yase::BufferManager::Initialize(256);
+    auto start = std::chrono::steady_clock::now();
+    {
+      yase::Table table("mytable_startup", kRecordSize, false, PAGE_SIZE, true);
+      double secs =
+          std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      ASSERT_EQ(table.file.GetPageCount(), pages);
+      ASSERT_EQ(table.next_free_pid.GetPageNum(), pages - 1);
+      std::cout << "Reopen " << pages << " pages (" << pages * (PAGE_SIZE / 1024) / 1024
+                << " MB): " << secs * 1000 << " ms" << std::endl;
+    }
+    yase::BufferManager::Uninitialize();
+  }
+  int ret = system("rm -rf mytable_startup mytable_startup.dir");
+  LOG_IF(FATAL, ret == -1) << "Error cleaning up testing files";
+}
+
 int main(int argc, char **argv) {
   yase::LogManager::Initialize("log_file", 1);
   ::google::InitGoogleLogging(argv[0]);
@@ -19,25 +19,30 @@ namespace yase {
 // Page ID - a 64-bit integer
 struct PageId {
   // Represents an Invalid ID
-  static const uint64_t kInvalidValue = ~uint64_t{0};
+  static constexpr uint64_t kInvalidValue = ~uint64_t{0};
 
   // Structure of the Page ID:
-  // |---32 bits--|--16 bits--|--16 bits--|
-  // |  File ID   | Page Num  |  Unused  |
+  // |--16 bits--|---32 bits---|--16 bits--|
+  // |  File ID  |  Page Num   |  Unused   |
+  // i.e., up to 2^32 - 1 pages (16TB with 4KB pages) per file
   uint64_t value;
 
+  // Largest valid page number and file ID
+  static constexpr uint32_t kMaxPageNum = 0xfffffffe;
+  static constexpr uint32_t kMaxFileId = 0xffff;
+
   // Constructors
   PageId() : value(kInvalidValue) {}
   PageId(int file_id, uint32_t page_num) {
-    value = (((uint64_t)file_id) << 32UL) | (((uint64_t)page_num) << 16UL);
+    value = (((uint64_t)file_id) << 48UL) | (((uint64_t)page_num) << 16UL);
   }
   PageId(uint64_t value) : value(value) {
     LOG_IF(FATAL, !IsValid()) << "Invalid value";
   }
 
   inline bool IsValid() { return value != kInvalidValue; }
-  inline uint32_t GetPageNum() const { return (value & 0xffffffff) >> 16; }
-  inline uint32_t GetFileId() const { return value >> 32UL; }
+  inline uint32_t GetPageNum() const { return (value >> 16UL) & 0xffffffff; }
+  inline uint32_t GetFileId() const { return value >> 48UL; }
 
   // Custom operator
   bool operator()(const PageId& lhs, const PageId& rhs) const {
@@ -48,8 +53,9 @@ struct PageId {
   }
 };
 
-// Record ID - Same as PageId, but uses the 8 LSBs: 
-// |---32 bits--|--16 bits--|--16 bits--|
+// Record ID - Same as PageId, but uses the 16 LSBs for the slot:
+// |--16 bits--|---32 bits---|--16 bits--|
+// |  File ID  |  Page Num   |  Slot ID  |
 struct RID : PageId {
   // Constructors
   RID(uint64_t v) { value = v;}